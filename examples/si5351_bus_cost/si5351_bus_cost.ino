@@ -0,0 +1,176 @@
+/*
+ * si5351_bus_cost.ino - Measure the bus cost of Si5351Arduino library calls
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs each library call over a grid of frequencies on every output,
+ * then replays the setup() of the other example sketches, and prints
+ * one CSV line per call:
+ *
+ *   api,clk,freq_hz,result,us
+ *
+ * The time of a call is dominated by its I2C traffic, so the "us" column
+ * tracks the bus cost at a given bus speed. Each API has a time budget
+ * below; a call over budget is flagged on its line and the run ends with
+ * "RESULT,FAIL" instead of "RESULT,PASS", so a script capturing the
+ * serial output can catch regressions.
+ *
+ * If the library and this sketch are built with SI5351_BUS_STATS defined
+ * (e.g. in PlatformIO build_flags), each line also gets the exact
+ * transaction and byte counts of the call:
+ *
+ *   api,clk,freq_hz,result,us,txn,bytes_written,bytes_read,errors
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+
+// Per-call budgets in microseconds at the default 100 kHz bus speed
+#define BUDGET_INIT_US          20000UL
+#define BUDGET_RESET_US         30000UL
+#define BUDGET_SET_FREQ_US      6000UL
+#define BUDGET_SET_CORR_US      8000UL
+#define BUDGET_SET_PLL_INPUT_US 1500UL
+
+Si5351 si5351;
+uint8_t failed = 0;
+
+const uint64_t freq_grid[] =
+{
+  1000000ULL,       // 10 kHz
+  10000000ULL,      // 100 kHz
+  100000000ULL,     // 1 MHz
+  700000000ULL,     // 7 MHz
+  1407600000ULL,    // 14.076 MHz
+  5000000000ULL,    // 50 MHz
+  10000000000ULL,   // 100 MHz
+  15000000000ULL,   // 150 MHz
+  20000000000ULL    // 200 MHz
+};
+
+#ifdef SI5351_BUS_STATS
+#define TIME_CALL(api, clk, freq, budget, call) \
+  do { \
+    si5351.reset_bus_stats(); \
+    uint32_t t0 = micros(); \
+    uint8_t res = (call); \
+    report(api, clk, freq, res, micros() - t0, budget); \
+  } while(0)
+#else
+#define TIME_CALL(api, clk, freq, budget, call) \
+  do { \
+    uint32_t t0 = micros(); \
+    uint8_t res = (call); \
+    report(api, clk, freq, res, micros() - t0, budget); \
+  } while(0)
+#endif
+
+void report(const char *api, int8_t clk, uint64_t freq, uint8_t result, uint32_t us, uint32_t budget)
+{
+  Serial.print(api);
+  Serial.print(',');
+  Serial.print(clk);
+  Serial.print(',');
+  Serial.print((uint32_t)(freq / SI5351_FREQ_MULT));
+  Serial.print(',');
+  Serial.print(result);
+  Serial.print(',');
+  Serial.print(us);
+#ifdef SI5351_BUS_STATS
+  struct Si5351BusStats stats;
+  si5351.get_bus_stats(SI5351_API_COUNT, &stats);
+  Serial.print(',');
+  Serial.print(stats.transactions);
+  Serial.print(',');
+  Serial.print(stats.bytes_written);
+  Serial.print(',');
+  Serial.print(stats.bytes_read);
+  Serial.print(',');
+  Serial.print(stats.errors);
+#endif
+  if(us > budget)
+  {
+    Serial.print(",OVER_BUDGET");
+    failed = 1;
+  }
+  Serial.println();
+}
+
+void setup()
+{
+  uint8_t clk, i;
+
+  Serial.begin(57600);
+#ifdef SI5351_BUS_STATS
+  Serial.println("api,clk,freq_hz,result,us,txn,bytes_written,bytes_read,errors");
+#else
+  Serial.println("api,clk,freq_hz,result,us");
+#endif
+
+  TIME_CALL("init", -1, 0, BUDGET_INIT_US, si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0) ? 0 : 1);
+  TIME_CALL("reset", -1, 0, BUDGET_RESET_US, (si5351.reset(), 0));
+
+  // set_freq() over the grid on every output
+  for(clk = 0; clk < 8; clk++)
+  {
+    for(i = 0; i < sizeof(freq_grid) / sizeof(freq_grid[0]); i++)
+    {
+      TIME_CALL("set_freq", clk, freq_grid[i], BUDGET_SET_FREQ_US,
+        si5351.set_freq(freq_grid[i], (enum si5351_clock)clk));
+    }
+    si5351.reset();
+  }
+
+  TIME_CALL("set_correction", -1, 0, BUDGET_SET_CORR_US,
+    (si5351.set_correction(1200, SI5351_PLL_INPUT_XO), 0));
+  TIME_CALL("set_pll_input", -1, 0, BUDGET_SET_PLL_INPUT_US,
+    (si5351.set_pll_input(SI5351_PLLB, SI5351_PLL_INPUT_XO), 0));
+
+  // Replay of si5351_example
+  si5351.reset();
+  TIME_CALL("example", 0, 1400000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq(1400000000ULL, SI5351_CLK0));
+  TIME_CALL("example", 1, 17500000000ULL, BUDGET_SET_FREQ_US,
+    (si5351.set_ms_source(SI5351_CLK1, SI5351_PLLB),
+    si5351.set_freq_manual(17500000000ULL, 70000000000ULL, SI5351_CLK1)));
+
+  // Replay of si5351_phase
+  si5351.reset();
+  TIME_CALL("phase", 0, 1410000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq_manual(1410000000ULL, 70500000000ULL, SI5351_CLK0));
+  TIME_CALL("phase", 1, 1410000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq_manual(1410000000ULL, 70500000000ULL, SI5351_CLK1));
+  TIME_CALL("phase", 1, 0, BUDGET_SET_FREQ_US,
+    (si5351.set_phase(SI5351_CLK0, 0), si5351.set_phase(SI5351_CLK1, 50),
+    si5351.pll_reset(SI5351_PLLA), 0));
+
+  // Replay of si5351_clk67_example
+  si5351.reset();
+  TIME_CALL("clk67", 0, 1400000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq(1400000000ULL, SI5351_CLK0));
+  TIME_CALL("clk67", 6, 2300000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq(2300000000ULL, SI5351_CLK6));
+  TIME_CALL("clk67", 7, 1234567800ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq(1234567800ULL, SI5351_CLK7));
+  TIME_CALL("clk67", 7, 8740000000ULL, BUDGET_SET_FREQ_US,
+    si5351.set_freq(8740000000ULL, SI5351_CLK7));
+
+  Serial.println(failed ? "RESULT,FAIL" : "RESULT,PASS");
+}
+
+void loop()
+{
+}
@@ -116,7 +116,7 @@ static void vfo_interface(void)
     cal_factor = (int32_t)(target_freq - rx_freq) + old_cal;
     si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
     si5351.set_pll(SI5351_PLL_FIXED, SI5351_PLLA);
-    si5351.pll_reset(SI5351_PLLA);
+    si5351.pll_reset_wait(SI5351_PLLA, 10000);
     si5351.set_freq(target_freq, SI5351_CLK0);
     Serial.print(F("Current difference:"));
     Serial.println(cal_factor);
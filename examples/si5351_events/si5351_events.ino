@@ -0,0 +1,83 @@
+/*
+ * si5351_events.ino - Interrupt-driven status events with Si5351Arduino library
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Watches for loss of lock and loss of signal without polling the
+ * status registers. The INTB pin of the Si5351 (20-pin packages only)
+ * goes to digital pin 2, with a pull-up, since INTB is open-drain.
+ * The status registers are only read after INTB has fired.
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+
+#define INTB_PIN 2
+
+Si5351 si5351;
+
+void intb_isr()
+{
+  si5351.int_notify();
+}
+
+void lol_a(uint8_t active)
+{
+  Serial.print("PLLA lost lock, ");
+  Serial.println(active ? "still unlocked" : "locked again");
+}
+
+void los(uint8_t active)
+{
+  Serial.print("CLKIN lost, ");
+  Serial.println(active ? "still missing" : "back again");
+}
+
+void sys_init(uint8_t active)
+{
+  // The Si5351 has been through its own startup (e.g. after a brownout),
+  // so its registers are back at their defaults
+  Serial.println("Si5351 restarted, setting it up again");
+  si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+  si5351.set_freq(1000000000ULL, SI5351_CLK0);
+  si5351.enable_events(SI5351_STATUS_SYS_INIT | SI5351_STATUS_LOL_A | SI5351_STATUS_LOS);
+}
+
+void setup()
+{
+  // Start serial and initialize the Si5351
+  Serial.begin(57600);
+  si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+  si5351.set_freq(1000000000ULL, SI5351_CLK0);
+
+  // Call back on these events, and have only them pull INTB low
+  si5351.set_event_callback(SI5351_STATUS_LOL_A, lol_a);
+  si5351.set_event_callback(SI5351_STATUS_LOS, los);
+  si5351.set_event_callback(SI5351_STATUS_SYS_INIT, sys_init);
+  si5351.enable_events(SI5351_STATUS_SYS_INIT | SI5351_STATUS_LOL_A | SI5351_STATUS_LOS);
+
+  pinMode(INTB_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(INTB_PIN), intb_isr, FALLING);
+
+  // Clear whatever was flagged during startup
+  si5351.int_notify();
+}
+
+void loop()
+{
+  // Costs nothing on the bus until INTB fires
+  si5351.service_events();
+}
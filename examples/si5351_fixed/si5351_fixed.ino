@@ -0,0 +1,57 @@
+/*
+ * si5351_fixed.ino - Compile-time frequency plans with Si5351Arduino library
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * When the output frequencies are fixed, Si5351::plan() lets the
+ * compiler do all of the frequency math. The template arguments are the
+ * reference frequency in Hz, the output frequency in Hz * 100, the
+ * output, and optionally the frequency correction in parts-per-billion.
+ * Using init_fixed() instead of init() keeps the run-time frequency math
+ * out of the sketch altogether.
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+
+Si5351 si5351;
+
+// 10 MHz on CLK0 and 4 MHz on CLK6, with a 25 MHz crystal
+constexpr struct Si5351ConstPlan clk0_plan = Si5351::plan<25000000, 1000000000ULL, SI5351_CLK0>();
+constexpr struct Si5351ConstPlan clk6_plan = Si5351::plan<25000000, 400000000ULL, SI5351_CLK6>();
+
+void setup()
+{
+  bool i2c_found;
+
+  // Start serial and initialize the Si5351
+  Serial.begin(57600);
+  i2c_found = si5351.init_fixed(SI5351_CRYSTAL_LOAD_8PF);
+  if(!i2c_found)
+  {
+    Serial.println("Device not found on I2C bus!");
+  }
+
+  si5351.load_plan(&clk0_plan);
+  si5351.load_plan(&clk6_plan);
+
+  // set_freq() does not enable CLK6 or CLK7, and neither does load_plan()
+  si5351.output_enable(SI5351_CLK6, 1);
+}
+
+void loop()
+{
+}
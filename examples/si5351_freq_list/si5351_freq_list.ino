@@ -0,0 +1,62 @@
+/*
+ * si5351_freq_list.ino - Fast frequency list playback with Si5351Arduino library
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * All of the frequency math for the list is done once in setup(), so each
+ * step in loop() only costs one short I2C write. The dwell callback is
+ * where you would take a measurement at each frequency.
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+
+#define STEPS 40
+
+Si5351 si5351;
+struct Si5351FreqStep steps[STEPS];
+uint16_t step_count;
+
+void dwell(uint16_t step)
+{
+  // Take a reading here
+  delay(10);
+}
+
+void setup()
+{
+  uint64_t freqs[STEPS];
+  uint16_t i;
+
+  // Start serial and initialize the Si5351
+  Serial.begin(57600);
+  si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+
+  // Sweep CLK0 from 7.000 MHz to 7.200 MHz in 5 kHz steps
+  for(i = 0; i < STEPS; i++)
+  {
+    freqs[i] = (7000000ULL + i * 5000ULL) * SI5351_FREQ_MULT;
+  }
+
+  step_count = si5351.compile_freq_list(SI5351_CLK0, freqs, STEPS, steps);
+  Serial.print("Compiled steps: ");
+  Serial.println(step_count);
+}
+
+void loop()
+{
+  si5351.play_freq_list(SI5351_CLK0, steps, step_count, dwell);
+}
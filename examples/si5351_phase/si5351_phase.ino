@@ -33,6 +33,12 @@
  * you simply enter that multiple into the phase register. Remember when
  * setting multiple outputs to be phase-related to each other, they each need
  * to be referenced to the same PLL.
+ *
+ * The set_freq_phased() method does all of this for you: it picks a PLL
+ * frequency that gives every requested phase offset exactly, sets the
+ * Multisynths and phase registers, and resets the PLL. After that,
+ * retune_phased() moves the whole group to a new frequency by rewriting
+ * only the PLL, which keeps the outputs in phase.
  */
 
 #include "si5351.h"
@@ -71,6 +77,17 @@ void setup()
   // We need to reset the PLL before they will be in phase alignment
   si5351.pll_reset(SI5351_PLLA);
 
+  delay(5000);
+
+  // The same I/Q pair, but letting the library do the math
+  enum si5351_clock iq_clocks[2] = {SI5351_CLK0, SI5351_CLK1};
+  uint16_t iq_phases[2] = {0, 90};
+  si5351.set_freq_phased(freq, iq_clocks, iq_phases, 2);
+
+  // Retune the pair to 14.2 MHz without losing the phase offset
+  delay(5000);
+  si5351.retune_phased(1420000000ULL);
+
   // Query a status update and wait a bit to let the Si5351 populate the
   // status flags correctly.
   si5351.update_status();
@@ -0,0 +1,17 @@
+/* Generated by cbgen from si5351_regs.txt */
+
+#include <si5351.h>
+
+const struct Si5351RegValue si5351_regs[] PROGMEM = {
+  {3, 0xF8}, {16, 0x0C}, {17, 0x0C}, {18, 0x2C}, {19, 0x0C}, {20, 0x0C},
+  {21, 0x0C}, {22, 0x2C}, {23, 0x2C}, {26, 0x00}, {27, 0x01}, {28, 0x00},
+  {29, 0x0E}, {30, 0x00}, {31, 0x00}, {32, 0x00}, {33, 0x00}, {34, 0x42},
+  {35, 0x40}, {36, 0x00}, {37, 0x0F}, {38, 0x47}, {39, 0xFA}, {40, 0x60},
+  {41, 0x40}, {42, 0x00}, {43, 0x01}, {44, 0x00}, {45, 0x26}, {46, 0x00},
+  {47, 0x00}, {48, 0x00}, {49, 0x00}, {50, 0x00}, {51, 0x01}, {52, 0x00},
+  {53, 0x0E}, {54, 0x00}, {55, 0x00}, {56, 0x00}, {57, 0x00}, {58, 0x00},
+  {59, 0x01}, {60, 0x00}, {61, 0x01}, {62, 0x00}, {63, 0x00}, {64, 0x00},
+  {65, 0x00}, {162, 0x00}, {163, 0x00}, {164, 0x00}, {183, 0x92}
+};
+
+const uint16_t si5351_regs_count = 53;
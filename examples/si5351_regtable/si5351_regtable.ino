@@ -0,0 +1,51 @@
+/*
+ * si5351_regtable.ino - Loading a flash register table with Si5351Arduino library
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * For products with fixed output frequencies, the register values can
+ * be worked out ahead of time on the host instead of on the Arduino.
+ * si5351_regs.h was made by the cbgen tool in the extras/cbgen folder
+ * from si5351_regs.txt (10 MHz on CLK0, 25 MHz on CLK1 and 144 MHz on
+ * CLK2). cbgen can also convert a register list exported by Silicon Labs
+ * ClockBuilder.
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+#include "si5351_regs.h"
+
+Si5351 si5351;
+
+void setup()
+{
+  bool i2c_found;
+
+  // Start serial and initialize the Si5351
+  Serial.begin(57600);
+  i2c_found = si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+  if(!i2c_found)
+  {
+    Serial.println("Device not found on I2C bus!");
+  }
+
+  // Write the whole table in a few bursts, with no frequency math
+  si5351.load_regs(si5351_regs, si5351_regs_count);
+}
+
+void loop()
+{
+}
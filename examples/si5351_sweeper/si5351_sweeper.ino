@@ -44,6 +44,7 @@ int delaytime = 50;
 #include "Wire.h"
 
 Si5351 si5351;
+struct Si5351Sweep sweep;
 
 
 void setup()
@@ -83,14 +84,13 @@ void loop()
   if(inData == 'M' || inData == 'm')
   {
     inData = 0;
-    unsigned long freqstep = (stopFreq - startFreq) / steps;
-    for(int i = 0; i < (steps + 1); i++ )
+    int i = 0;
+    si5351.start_sweep(&sweep, SI5351_CLK0, startFreq * SI5351_FREQ_MULT, stopFreq * SI5351_FREQ_MULT, steps + 1, SI5351_SWEEP_LINEAR);
+    do
     {
-      unsigned long freq = startFreq + (freqstep*i);
-      si5351.set_freq(freq * SI5351_FREQ_MULT, SI5351_CLK0);
-      analogWrite(analogpin, map(i, 0, steps, 0, 255));
+      analogWrite(analogpin, map(i++, 0, steps, 0, 255));
       delay(delaytime);
-    }
+    } while(si5351.sweep_step(&sweep));
     si5351.output_enable(SI5351_CLK0, 0);
   }
 
@@ -100,12 +100,11 @@ void loop()
     inData = 0;
     while(running)
     {
-      unsigned long freqstep = (stopFreq - startFreq) / steps;
-      for (int i = 0; i < (steps + 1); i++ )
+      int i = 0;
+      si5351.start_sweep(&sweep, SI5351_CLK0, startFreq * SI5351_FREQ_MULT, stopFreq * SI5351_FREQ_MULT, steps + 1, SI5351_SWEEP_LINEAR);
+      do
       {
-        unsigned long freq = startFreq + (freqstep * i);
-        si5351.set_freq(freq * SI5351_FREQ_MULT, SI5351_CLK0);
-        analogWrite(analogpin, map(i, 0, steps, 0, 255));
+        analogWrite(analogpin, map(i++, 0, steps, 0, 255));
         delay(delaytime);
         if(Serial.available() > 0)   // see if incoming serial data:
         {
@@ -116,7 +115,7 @@ void loop()
             inData = 0;
           }
         }
-      }
+      } while(running && si5351.sweep_step(&sweep));
     }
 
     si5351.output_enable(SI5351_CLK0, 0);
@@ -0,0 +1,84 @@
+/*
+ * si5351_symbols.ino - Timed symbol playback with Si5351Arduino library
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plays a WSPR-style transmission: 162 symbols of 4-FSK with 1.4648 Hz
+ * tone spacing and a symbol period of 8192/12000 seconds. The tone
+ * math is done once before the transmission, so each symbol edge only
+ * costs one short I2C burst.
+ *
+ * A real beacon would fill the symbols array with an encoder such as
+ * the Etherkit JTEncode library; here it is just a test pattern.
+ */
+
+#include "si5351.h"
+#include "Wire.h"
+
+#define WSPR_SYMBOL_COUNT 162
+#define WSPR_TONE_COUNT   4
+#define WSPR_TONE_SPACING 146           // 1.46 Hz in Hz * 100
+#define WSPR_PERIOD_NS    682666667UL   // 8192/12000 s
+#define WSPR_FREQ         1409710000ULL // 14.0971 MHz in Hz * 100
+
+Si5351 si5351;
+struct Si5351FreqStep tones[WSPR_TONE_COUNT];
+struct Si5351Symbols wspr;
+uint8_t symbols[WSPR_SYMBOL_COUNT];
+
+void setup()
+{
+  uint8_t i;
+
+  // Start serial and initialize the Si5351
+  Serial.begin(57600);
+  si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+
+  // Use the best fraction for each tone, for the most accurate spacing
+  si5351.set_frac_solver(SI5351_FRAC_BEST_RATIONAL);
+
+  // Set up the output and the tone table
+  si5351.set_freq(WSPR_FREQ, SI5351_CLK0);
+  si5351.compile_tones(SI5351_CLK0, WSPR_FREQ, WSPR_TONE_SPACING, WSPR_TONE_COUNT, tones);
+
+  // Test pattern
+  for(i = 0; i < WSPR_SYMBOL_COUNT; i++)
+  {
+    symbols[i] = i % WSPR_TONE_COUNT;
+  }
+}
+
+void loop()
+{
+  struct Si5351SymbolStats stats;
+
+  // Send the transmission; symbol_tick() must be called often
+  si5351.start_symbols(&wspr, SI5351_CLK0, tones, symbols, WSPR_SYMBOL_COUNT, WSPR_PERIOD_NS);
+  while(si5351.symbol_tick(&wspr))
+  {
+  }
+  si5351.output_enable(SI5351_CLK0, 0);
+
+  si5351.get_symbol_stats(&wspr, &stats);
+  Serial.print("Symbols: ");
+  Serial.print(stats.symbols);
+  Serial.print("  Edge jitter (us): ");
+  Serial.println(stats.max_late_us - stats.min_late_us);
+
+  // Wait for the next transmission
+  delay(10000);
+  si5351.output_enable(SI5351_CLK0, 1);
+}
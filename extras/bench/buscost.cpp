@@ -0,0 +1,301 @@
+/*
+ * buscost.cpp - Bus-cost regression benchmark for the Si5351 library
+ *
+ * This is a host program, not an Arduino sketch. It runs the library
+ * against the Si5351Sim chip model and prints one CSV line per call:
+ *
+ *   api,clk,freq_hz,result,transactions,bytes_written,bytes_read,reads
+ *
+ * where reads is the number of read transactions. The calls are
+ * init(), reset(), set_freq() over a grid of frequencies on every
+ * output, set_correction(), set_pll_input() and replays of the setup()
+ * of the example sketches.
+ *
+ * Build and run it with "make -C extras buscost-check", which compares
+ * the counters with bench/buscost_baseline.csv and fails if any call
+ * costs more than its baseline. After a change that is meant to alter
+ * the bus cost, "make -C extras buscost-baseline" writes a new baseline.
+ *
+ * Usage: buscost [baseline.csv]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+#define MAX_ROWS 256
+#define KEY_LEN 64
+
+struct row
+{
+	char key[KEY_LEN];
+	uint32_t counts[4];
+};
+
+static Si5351Sim chip;
+static Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+
+static struct row rows[MAX_ROWS];
+static uint16_t row_count = 0;
+static struct row base[MAX_ROWS];
+static uint16_t base_count = 0;
+
+static const uint64_t freq_grid[] =
+{
+	1000000ULL,       // 10 kHz
+	10000000ULL,      // 100 kHz
+	100000000ULL,     // 1 MHz
+	700000000ULL,     // 7 MHz
+	1407600000ULL,    // 14.076 MHz
+	5000000000ULL,    // 50 MHz
+	10000000000ULL,   // 100 MHz
+	15000000000ULL,   // 150 MHz
+	20000000000ULL    // 200 MHz
+};
+
+/*
+ * A call is identified by its api, clk and freq columns and by how many
+ * identical calls came before it in the list, so that the baseline
+ * still lines up if calls are added elsewhere.
+ */
+static void make_key(char *key, const char *api, int clk, unsigned long long freq_hz,
+	const struct row *list, uint16_t count)
+{
+	char prefix[KEY_LEN - 12];
+	size_t len;
+	int n = 0;
+
+	snprintf(prefix, sizeof(prefix), "%s,%d,%llu#", api, clk, freq_hz);
+	len = strlen(prefix);
+	for(uint16_t i = 0; i < count; i++)
+	{
+		if(strncmp(list[i].key, prefix, len) == 0)
+		{
+			n++;
+		}
+	}
+	snprintf(key, KEY_LEN, "%s%d", prefix, n);
+}
+
+static uint32_t txn0, written0, read0, reads0;
+
+static void start(void)
+{
+	txn0 = chip.transactions;
+	written0 = chip.bytes_written;
+	read0 = chip.bytes_read;
+	reads0 = chip.reads;
+}
+
+static void report(const char *api, int clk, uint64_t freq, int result)
+{
+	struct row *r;
+
+	if(row_count >= MAX_ROWS)
+	{
+		fprintf(stderr, "buscost: too many calls\n");
+		exit(2);
+	}
+	r = &rows[row_count];
+
+	make_key(r->key, api, clk, freq / SI5351_FREQ_MULT, rows, row_count);
+	r->counts[0] = chip.transactions - txn0;
+	r->counts[1] = chip.bytes_written - written0;
+	r->counts[2] = chip.bytes_read - read0;
+	r->counts[3] = chip.reads - reads0;
+	row_count++;
+
+	printf("%s,%d,%llu,%d,%u,%u,%u,%u\n", api, clk, (unsigned long long)(freq / SI5351_FREQ_MULT), result,
+		r->counts[0], r->counts[1], r->counts[2], r->counts[3]);
+}
+
+#define MEASURE(api, clk, freq, call) \
+	do { \
+		start(); \
+		int res = (call); \
+		report(api, clk, freq, res); \
+	} while(0)
+
+static void run(void)
+{
+	enum si5351_clock iq_clocks[2] = {SI5351_CLK0, SI5351_CLK1};
+	uint16_t iq_phases[2] = {0, 90};
+	uint8_t clk, i;
+
+	printf("api,clk,freq_hz,result,transactions,bytes_written,bytes_read,reads\n");
+
+	MEASURE("init", -1, 0, si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0) ? 0 : 1);
+	MEASURE("reset", -1, 0, (si5351.reset(), 0));
+
+	// set_freq() over the grid on every output
+	for(clk = 0; clk < 8; clk++)
+	{
+		for(i = 0; i < sizeof(freq_grid) / sizeof(freq_grid[0]); i++)
+		{
+			MEASURE("set_freq", clk, freq_grid[i], si5351.set_freq(freq_grid[i], (enum si5351_clock)clk));
+		}
+		si5351.reset();
+	}
+
+	MEASURE("set_correction", -1, 0, (si5351.set_correction(1200, SI5351_PLL_INPUT_XO), 0));
+	MEASURE("set_pll_input", -1, 0, (si5351.set_pll_input(SI5351_PLLB, SI5351_PLL_INPUT_XO), 0));
+
+	// Replay of si5351_example
+	si5351.reset();
+	MEASURE("example", 0, 1400000000ULL, si5351.set_freq(1400000000ULL, SI5351_CLK0));
+	MEASURE("example", 1, 17500000000ULL,
+		(si5351.set_ms_source(SI5351_CLK1, SI5351_PLLB),
+		si5351.set_freq_manual(17500000000ULL, 70000000000ULL, SI5351_CLK1)));
+	MEASURE("example", -1, 0, (si5351.update_status(), 0));
+
+	// Replay of si5351_phase
+	si5351.reset();
+	MEASURE("phase", 0, 1410000000ULL, si5351.set_freq_manual(1410000000ULL, 70500000000ULL, SI5351_CLK0));
+	MEASURE("phase", 1, 1410000000ULL, si5351.set_freq_manual(1410000000ULL, 70500000000ULL, SI5351_CLK1));
+	MEASURE("phase", 1, 0,
+		(si5351.set_phase(SI5351_CLK0, 0), si5351.set_phase(SI5351_CLK1, 50),
+		si5351.pll_reset(SI5351_PLLA), 0));
+	MEASURE("phase", 0, 1410000000ULL, si5351.set_freq_phased(1410000000ULL, iq_clocks, iq_phases, 2));
+	MEASURE("phase", 0, 1420000000ULL, si5351.retune_phased(1420000000ULL));
+
+	// Replay of si5351_clk67_example
+	si5351.reset();
+	MEASURE("clk67", 0, 1400000000ULL, si5351.set_freq(1400000000ULL, SI5351_CLK0));
+	MEASURE("clk67", 6, 2300000000ULL, si5351.set_freq(2300000000ULL, SI5351_CLK6));
+	MEASURE("clk67", 7, 1234567800ULL, si5351.set_freq(1234567800ULL, SI5351_CLK7));
+	MEASURE("clk67", 7, 8740000000ULL, si5351.set_freq(8740000000ULL, SI5351_CLK7));
+
+	// Replay of si5351_outputs
+	si5351.reset();
+	MEASURE("outputs", 0, 1400000000ULL, si5351.set_freq(1400000000ULL, SI5351_CLK0));
+	MEASURE("outputs", -1, 0,
+		(si5351.set_clock_fanout(SI5351_FANOUT_XO, 1),
+		si5351.set_clock_fanout(SI5351_FANOUT_MS, 1), 0));
+	MEASURE("outputs", 1, 0,
+		(si5351.set_clock_source(SI5351_CLK1, SI5351_CLK_SRC_XTAL),
+		si5351.output_enable(SI5351_CLK1, 1), 0));
+	MEASURE("outputs", 2, 0,
+		(si5351.set_clock_source(SI5351_CLK2, SI5351_CLK_SRC_MS0),
+		si5351.output_enable(SI5351_CLK2, 1), 0));
+	MEASURE("outputs", 0, 1000000000ULL, si5351.set_freq(1000000000ULL, SI5351_CLK0));
+}
+
+static int load_baseline(const char *baseline)
+{
+	FILE *f = fopen(baseline, "r");
+	char line[256];
+	char api[32];
+	char *p;
+	int clk, result;
+	unsigned long long freq_hz;
+	unsigned int counts[4];
+
+	if(f == NULL)
+	{
+		perror(baseline);
+		return 1;
+	}
+
+	while(fgets(line, sizeof(line), f) != NULL && base_count < MAX_ROWS)
+	{
+		p = strchr(line, ',');
+		if(p == NULL || (size_t)(p - line) >= sizeof(api))
+		{
+			continue;
+		}
+		memcpy(api, line, p - line);
+		api[p - line] = '\0';
+		if(sscanf(p + 1, "%d,%llu,%d,%u,%u,%u,%u", &clk, &freq_hz, &result,
+			&counts[0], &counts[1], &counts[2], &counts[3]) != 7)
+		{
+			// The header line
+			continue;
+		}
+
+		make_key(base[base_count].key, api, clk, freq_hz, base, base_count);
+		for(uint8_t i = 0; i < 4; i++)
+		{
+			base[base_count].counts[i] = counts[i];
+		}
+		base_count++;
+	}
+	fclose(f);
+	return 0;
+}
+
+// Fail if any call costs more than its baseline
+static int check(void)
+{
+	static const char *names[4] = {"transactions", "bytes_written", "bytes_read", "reads"};
+	int failed = 0;
+	uint16_t i, j;
+	uint8_t k;
+
+	for(i = 0; i < row_count; i++)
+	{
+		for(j = 0; j < base_count; j++)
+		{
+			if(strcmp(rows[i].key, base[j].key) == 0)
+			{
+				break;
+			}
+		}
+		if(j == base_count)
+		{
+			fprintf(stderr, "buscost: %s has no baseline\n", rows[i].key);
+			continue;
+		}
+
+		for(k = 0; k < 4; k++)
+		{
+			if(rows[i].counts[k] > base[j].counts[k])
+			{
+				fprintf(stderr, "buscost: %s %s went from %u to %u\n", rows[i].key, names[k],
+					base[j].counts[k], rows[i].counts[k]);
+				failed = 1;
+			}
+			else if(rows[i].counts[k] < base[j].counts[k])
+			{
+				fprintf(stderr, "buscost: %s %s went down from %u to %u\n", rows[i].key, names[k],
+					base[j].counts[k], rows[i].counts[k]);
+			}
+		}
+	}
+
+	fprintf(stderr, "buscost: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 2)
+	{
+		fprintf(stderr, "usage: buscost [baseline.csv]\n");
+		return 2;
+	}
+	if(argc == 2 && load_baseline(argv[1]) != 0)
+	{
+		return 2;
+	}
+
+	run();
+
+	return (argc == 2) ? check() : 0;
+}
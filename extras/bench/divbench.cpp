@@ -0,0 +1,464 @@
+/*
+ * divbench.cpp - Division-count benchmark for the Si5351 frequency math
+ *
+ * This is a host program, not an Arduino sketch. On an 8-bit target the
+ * CPU time of set_freq() goes almost entirely into 64-bit divisions,
+ * each of which runs 64 shift-and-subtract steps in libgcc. This program
+ * builds the library with SI5351_MATH_STATS, runs set_freq() and
+ * set_correction() against the Si5351Sim chip model and counts:
+ *
+ *   div64      generic 64-bit divisions and modulos
+ *   div_steps  steps of the shorter divisions done by udiv_bounded()
+ *
+ * It does the same calls again with a model of the frequency math as it
+ * was before udiv_bounded() and the corrected reference cache were added,
+ * which did every division the generic way, and prints one CSV line per
+ * call:
+ *
+ *   api,clk,freq_hz,corr,old_div64,new_div64,new_div_steps,old_steps,new_steps
+ *
+ * where old_steps and new_steps are the total shift-and-subtract steps,
+ * counting 64 for each generic division. The old model has to give the
+ * same register values that the library wrote to the simulated chip, so
+ * the comparison is between two ways of working out the same result.
+ *
+ * Build and run it with "make -C extras divbench-check", which fails if
+ * the model does not match the library or if any call takes more steps
+ * than it did before.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "si5351_sim.h"
+
+#ifndef SI5351_MATH_STATS
+#error "divbench needs the library built with SI5351_MATH_STATS"
+#endif
+
+TwoWire Wire;
+
+#define DIV_STEPS 64
+
+static Si5351Sim chip;
+static Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+
+static const uint64_t freq_grid[] =
+{
+	1000000ULL,       // 10 kHz
+	10000000ULL,      // 100 kHz
+	100000000ULL,     // 1 MHz
+	700000000ULL,     // 7 MHz
+	1407600000ULL,    // 14.076 MHz
+	5000000000ULL,    // 50 MHz
+	9999999900ULL,    // 99.999999 MHz
+	12000000000ULL,   // 120 MHz
+	15000000000ULL,   // 150 MHz
+	20000000000ULL    // 200 MHz
+};
+
+static const int32_t corr_grid[] = {0, 1200, -35000};
+
+// CLK6 frequency, then a CLK7 frequency that has to share PLLB with it
+static const uint64_t ms67_grid[][2] =
+{
+	{1000000000ULL, 2000000000ULL},
+	{2300000000ULL, 4600000000ULL},
+	{2300000000ULL, 1234567800ULL},
+	{5000000000ULL, 2500000000ULL},
+	{12500000000ULL, 6250000000ULL}
+};
+
+static int failed = 0;
+static uint32_t old_div64_total = 0;
+static uint32_t new_div64_total = 0;
+static uint32_t new_steps_total = 0;
+
+/******************************************************/
+/* The frequency math before udiv_bounded() was added */
+/******************************************************/
+
+static uint32_t old_div64;
+static int32_t old_corr;
+static uint64_t old_plla_freq;
+static uint64_t old_pllb_freq;
+
+static uint64_t old_pll_calc(uint64_t freq, struct Si5351RegSet *reg)
+{
+	uint64_t ref_freq = SI5351_XTAL_FREQ * SI5351_FREQ_MULT;
+	uint32_t a, b, c;
+	uint64_t lltmp;
+
+	old_div64++;
+	ref_freq = ref_freq + (int32_t)((((((int64_t)old_corr) << 31) / 1000000000LL) * ref_freq) >> 31);
+
+	if(freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT;
+	}
+	if(freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT;
+	}
+
+	old_div64++;
+	a = freq / ref_freq;
+	if(a < SI5351_PLL_A_MIN)
+	{
+		freq = ref_freq * SI5351_PLL_A_MIN;
+	}
+	if(a > SI5351_PLL_A_MAX)
+	{
+		freq = ref_freq * SI5351_PLL_A_MAX;
+	}
+
+	old_div64 += 2;
+	b = (((uint64_t)(freq % ref_freq)) * RFRAC_DENOM) / ref_freq;
+	c = b ? RFRAC_DENOM : 1;
+
+	reg->p1 = 128 * a + ((128 * b) / c) - 512;
+	reg->p2 = 128 * b - c * ((128 * b) / c);
+	reg->p3 = c;
+
+	old_div64++;
+	lltmp = ref_freq * b;
+	lltmp /= c;
+	return lltmp + ref_freq * a;
+}
+
+static uint64_t old_multisynth_calc(uint64_t freq, uint64_t pll_freq, struct Si5351RegSet *reg)
+{
+	uint32_t a, b, c;
+	uint8_t divby4 = 0;
+
+	if(freq > SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT;
+	}
+	if(freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT;
+	}
+	if(freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
+	{
+		divby4 = 1;
+	}
+
+	if(pll_freq == 0)
+	{
+		if(divby4 == 0)
+		{
+			old_div64++;
+			a = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT / freq;
+			if(a == 5)
+			{
+				a = 4;
+			}
+			else if(a == 7)
+			{
+				a = 6;
+			}
+		}
+		else
+		{
+			a = 4;
+		}
+		b = 0;
+		c = 1;
+		pll_freq = a * freq;
+	}
+	else
+	{
+		old_div64++;
+		a = pll_freq / freq;
+		if(a < SI5351_MULTISYNTH_A_MIN)
+		{
+			old_div64++;
+			freq = pll_freq / SI5351_MULTISYNTH_A_MIN;
+		}
+		if(a > SI5351_MULTISYNTH_A_MAX)
+		{
+			old_div64++;
+			freq = pll_freq / SI5351_MULTISYNTH_A_MAX;
+		}
+
+		old_div64 += 2;
+		b = (pll_freq % freq * RFRAC_DENOM) / freq;
+		c = b ? RFRAC_DENOM : 1;
+	}
+
+	if(divby4)
+	{
+		reg->p1 = 0;
+		reg->p2 = 0;
+		reg->p3 = 1;
+	}
+	else
+	{
+		reg->p1 = 128 * a + ((128 * b) / c) - 512;
+		reg->p2 = 128 * b - c * ((128 * b) / c);
+		reg->p3 = c;
+	}
+
+	return pll_freq;
+}
+
+static uint64_t old_multisynth67_calc(uint64_t freq, uint64_t pll_freq, uint32_t *a)
+{
+	if(pll_freq == 0)
+	{
+		old_div64++;
+		*a = (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT - 100000000UL) / freq;
+		if(*a % 2 != 0)
+		{
+			(*a)++;
+		}
+		if(*a < SI5351_MULTISYNTH_A_MIN)
+		{
+			*a = SI5351_MULTISYNTH_A_MIN;
+		}
+		if(*a > SI5351_MULTISYNTH67_A_MAX)
+		{
+			*a = SI5351_MULTISYNTH67_A_MAX;
+		}
+		pll_freq = *a * freq;
+		if(pll_freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+		{
+			*a -= 2;
+			pll_freq = *a * freq;
+		}
+		else if(pll_freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT)
+		{
+			*a += 2;
+			pll_freq = *a * freq;
+		}
+		return pll_freq;
+	}
+
+	old_div64++;
+	if(pll_freq % freq)
+	{
+		return 0;
+	}
+	old_div64++;
+	*a = pll_freq / freq;
+	return 1;
+}
+
+// The R divider and the frequency the Multisynth has to make
+static uint8_t old_select_r_div(uint64_t *freq, uint64_t min_freq)
+{
+	uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+
+	while(r_div < SI5351_OUTPUT_CLK_DIV_128 && *freq >= min_freq && *freq < (min_freq << (7 - r_div)))
+	{
+		r_div++;
+	}
+	*freq <<= r_div;
+	return r_div;
+}
+
+/***************************/
+/* Checks against the chip */
+/***************************/
+
+static void read_params(uint8_t base, struct Si5351RegSet *reg, uint8_t *r_div)
+{
+	const uint8_t *p = &chip.regs[base];
+
+	reg->p3 = ((uint32_t)(p[5] & 0xF0) << 12) | ((uint32_t)p[0] << 8) | p[1];
+	reg->p1 = ((uint32_t)(p[2] & 0x03) << 16) | ((uint32_t)p[3] << 8) | p[4];
+	reg->p2 = ((uint32_t)(p[5] & 0x0F) << 16) | ((uint32_t)p[6] << 8) | p[7];
+	if(r_div != NULL)
+	{
+		*r_div = (p[2] >> 4) & 0x07;
+	}
+}
+
+static void expect(const char *what, const struct Si5351RegSet *model, uint8_t base,
+	int r_div_model)
+{
+	struct Si5351RegSet reg;
+	uint8_t r_div;
+
+	read_params(base, &reg, &r_div);
+	if(reg.p1 != model->p1 || reg.p2 != model->p2 || reg.p3 != model->p3
+		|| (r_div_model >= 0 && r_div != r_div_model))
+	{
+		fprintf(stderr, "divbench: %s is p1=%u p2=%u p3=%u r=%u, old model has p1=%u p2=%u p3=%u r=%d\n",
+			what, reg.p1, reg.p2, reg.p3, r_div, model->p1, model->p2, model->p3, r_div_model);
+		failed = 1;
+	}
+}
+
+static void start(void)
+{
+	si5351.reset_math_stats();
+	old_div64 = 0;
+}
+
+static void report(const char *api, int clk, uint64_t freq)
+{
+	struct Si5351MathStats stats;
+	uint32_t old_steps, new_steps;
+
+	si5351.get_math_stats(&stats);
+	old_steps = old_div64 * DIV_STEPS;
+	new_steps = stats.div64 * DIV_STEPS + stats.div_steps;
+
+	printf("%s,%d,%llu,%ld,%u,%u,%u,%u,%u\n", api, clk, (unsigned long long)(freq / SI5351_FREQ_MULT),
+		(long)old_corr, old_div64, stats.div64, stats.div_steps, old_steps, new_steps);
+
+	if(new_steps > old_steps)
+	{
+		fprintf(stderr, "divbench: %s on CLK%d at %llu Hz takes %u steps, up from %u\n", api, clk,
+			(unsigned long long)(freq / SI5351_FREQ_MULT), new_steps, old_steps);
+		failed = 1;
+	}
+
+	old_div64_total += old_div64;
+	new_div64_total += stats.div64;
+	new_steps_total += new_steps;
+}
+
+static void reset_both(void)
+{
+	si5351.reset();
+	old_plla_freq = SI5351_PLL_FIXED;
+	old_pllb_freq = SI5351_PLL_FIXED;
+}
+
+static void bench_set_correction(int32_t corr)
+{
+	struct Si5351RegSet reg;
+
+	start();
+	si5351.set_correction(corr, SI5351_PLL_INPUT_XO);
+
+	old_corr = corr;
+	old_pll_calc(old_plla_freq, &reg);
+	expect("PLLA", &reg, SI5351_PLLA_PARAMETERS, -1);
+	old_pll_calc(old_pllb_freq, &reg);
+	expect("PLLB", &reg, SI5351_PLLB_PARAMETERS, -1);
+
+	report("set_correction", -1, 0);
+}
+
+static void bench_set_freq(uint64_t freq)
+{
+	struct Si5351RegSet reg;
+	uint64_t ms_freq = freq;
+	uint8_t r_div;
+
+	start();
+	si5351.set_freq(freq, SI5351_CLK0);
+
+	if(freq > SI5351_MULTISYNTH_SHARE_MAX * SI5351_FREQ_MULT)
+	{
+		old_plla_freq = old_multisynth_calc(freq, 0, &reg);
+		old_pll_calc(old_plla_freq, &reg);
+		expect("PLLA", &reg, SI5351_PLLA_PARAMETERS, -1);
+	}
+	r_div = old_select_r_div(&ms_freq, SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT);
+	old_multisynth_calc(ms_freq, old_plla_freq, &reg);
+	expect("MS0", &reg, SI5351_CLK0_PARAMETERS, r_div);
+
+	report("set_freq", 0, freq);
+}
+
+static void bench_ms67(enum si5351_clock clk, uint64_t freq, uint8_t first)
+{
+	struct Si5351RegSet reg;
+	uint64_t ms_freq = freq;
+	uint32_t a = 0;
+	uint8_t r_div;
+	uint8_t ret;
+
+	start();
+	ret = si5351.set_freq(freq, clk);
+
+	if(first)
+	{
+		r_div = old_select_r_div(&ms_freq, SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT);
+		old_pllb_freq = old_multisynth67_calc(ms_freq, 0, &a);
+		old_pll_calc(old_pllb_freq, &reg);
+		expect("PLLB", &reg, SI5351_PLLB_PARAMETERS, -1);
+	}
+	else
+	{
+		// The shared PLLB has to be an even multiple of the new output
+		old_div64 += 2;
+		if(old_pllb_freq % freq != 0 || (old_pllb_freq / freq) % 2 != 0)
+		{
+			if(ret == 0)
+			{
+				fprintf(stderr, "divbench: CLK%d at %llu Hz was set, the old model refuses it\n",
+					(int)clk, (unsigned long long)(freq / SI5351_FREQ_MULT));
+				failed = 1;
+			}
+			report("set_freq", (int)clk, freq);
+			return;
+		}
+		r_div = old_select_r_div(&ms_freq, SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT);
+		old_multisynth67_calc(ms_freq, old_pllb_freq, &a);
+	}
+
+	if(chip.regs[SI5351_CLK6_PARAMETERS + (clk - SI5351_CLK6)] != (uint8_t)a)
+	{
+		fprintf(stderr, "divbench: MS%d is %u, old model has %u\n", (int)clk,
+			chip.regs[SI5351_CLK6_PARAMETERS + (clk - SI5351_CLK6)], a);
+		failed = 1;
+	}
+	if(((chip.regs[SI5351_CLK6_7_OUTPUT_DIVIDER] >> ((clk == SI5351_CLK6) ? 0 : 4)) & 0x07) != r_div)
+	{
+		fprintf(stderr, "divbench: R%d differs from the old model\n", (int)clk);
+		failed = 1;
+	}
+
+	report("set_freq", (int)clk, freq);
+}
+
+int main(void)
+{
+	uint8_t i, j;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+
+	printf("api,clk,freq_hz,corr,old_div64,new_div64,new_div_steps,old_steps,new_steps\n");
+
+	for(i = 0; i < sizeof(corr_grid) / sizeof(corr_grid[0]); i++)
+	{
+		reset_both();
+		bench_set_correction(corr_grid[i]);
+		for(j = 0; j < sizeof(freq_grid) / sizeof(freq_grid[0]); j++)
+		{
+			bench_set_freq(freq_grid[j]);
+		}
+
+		for(j = 0; j < sizeof(ms67_grid) / sizeof(ms67_grid[0]); j++)
+		{
+			reset_both();
+			bench_ms67(SI5351_CLK6, ms67_grid[j][0], 1);
+			bench_ms67(SI5351_CLK7, ms67_grid[j][1], 0);
+		}
+		si5351.set_correction(0, SI5351_PLL_INPUT_XO);
+	}
+
+	fprintf(stderr, "divbench: %u generic divisions before, %u now; %u steps before, %u now\n",
+		old_div64_total, new_div64_total, old_div64_total * DIV_STEPS, new_steps_total);
+	fprintf(stderr, "divbench: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
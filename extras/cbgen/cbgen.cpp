@@ -0,0 +1,440 @@
+/*
+ * cbgen.cpp - Make a PROGMEM register table for Si5351::load_regs()
+ *
+ * This is a host program, not an Arduino sketch. Build it from the root
+ * of the library with "make -C extras", which makes extras/build/cbgen,
+ * or by hand with:
+ *
+ *   g++ -std=c++11 -O2 -Iextras/host -Isrc \
+ *     extras/cbgen/cbgen.cpp src/si5351.cpp -o cbgen
+ *
+ * "make -C extras regtable-check" checks that the table in the
+ * si5351_regtable example is up to date with its spec, and
+ * "make -C extras regtable" rebuilds it.
+ *
+ * Run it as:
+ *
+ *   cbgen [-n name] input [output.h]
+ *
+ * The input is either a register list exported by Silicon Labs
+ * ClockBuilder (the C header or the CSV register map, one address and
+ * value pair per line), or a frequency spec for this library:
+ *
+ *   xtal 25000000
+ *   load 8
+ *   correction 0
+ *   clk0 10000000
+ *   clk1 144000000.25 pllb
+ *
+ * Frequencies are in Hz, with up to two decimal places. A frequency
+ * spec is run through the library itself, so the registers are exactly
+ * the ones init() and set_freq() would write on the target.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "si5351.h"
+
+TwoWire Wire;
+
+/*
+ * Records every register the library writes, and answers reads from
+ * the same image (so the status register always reads as ready).
+ */
+class CaptureBus : public Si5351Bus
+{
+public:
+	uint8_t image[256];
+	uint8_t written[256];
+
+	CaptureBus()
+	{
+		memset(image, 0, sizeof(image));
+		memset(written, 0, sizeof(written));
+	}
+
+	void begin(void) {}
+	void set_clock(uint32_t) {}
+	uint8_t probe(uint8_t) { return 0; }
+
+	uint8_t write(uint8_t, uint8_t addr, const uint8_t *data, uint8_t bytes)
+	{
+		for(uint8_t i = 0; i < bytes; i++)
+		{
+			image[(uint8_t)(addr + i)] = data[i];
+			written[(uint8_t)(addr + i)] = 1;
+		}
+		return 0;
+	}
+
+	uint8_t write_read(uint8_t, uint8_t addr, uint8_t *data, uint8_t bytes)
+	{
+		for(uint8_t i = 0; i < bytes; i++)
+		{
+			data[i] = image[(uint8_t)(addr + i)];
+		}
+		return 0;
+	}
+};
+
+static uint16_t reg_addr[256];
+static uint8_t reg_value[256];
+static uint16_t reg_count = 0;
+
+static void add_reg(unsigned long addr, unsigned long value)
+{
+	uint16_t i;
+
+	// A later value for the same register replaces the earlier one
+	for(i = 0; i < reg_count; i++)
+	{
+		if(reg_addr[i] == addr)
+		{
+			reg_value[i] = value;
+			return;
+		}
+	}
+	reg_addr[reg_count] = addr;
+	reg_value[reg_count] = value;
+	reg_count++;
+}
+
+// Parse "0x53", "53h" or "83" as a number, or return 0 if it is not one
+static int parse_number(const char *tok, unsigned long *val)
+{
+	size_t len = strlen(tok);
+	char *end;
+
+	if(len > 2 && tok[0] == '0' && (tok[1] == 'x' || tok[1] == 'X'))
+	{
+		*val = strtoul(tok + 2, &end, 16);
+		return *end == '\0';
+	}
+	if(len > 1 && (tok[len - 1] == 'h' || tok[len - 1] == 'H'))
+	{
+		char buf[32];
+		if(len >= sizeof(buf))
+		{
+			return 0;
+		}
+		memcpy(buf, tok, len - 1);
+		buf[len - 1] = '\0';
+		*val = strtoul(buf, &end, 16);
+		return *end == '\0';
+	}
+	*val = strtoul(tok, &end, 10);
+	return len > 0 && *end == '\0';
+}
+
+// Skip comments, preprocessor lines and blank lines
+static char *content(char *line)
+{
+	while(isspace((unsigned char)*line))
+	{
+		line++;
+	}
+	if(*line == '\0' || *line == '#' || *line == ';' || *line == '*' ||
+		(line[0] == '/' && (line[1] == '/' || line[1] == '*')))
+	{
+		return NULL;
+	}
+	return line;
+}
+
+/*
+ * A ClockBuilder register line holds exactly two numbers, the address
+ * and the value, e.g. "{ 0x0010, 0x4F }," or "16,4Fh".
+ */
+static int parse_register_line(char *line)
+{
+	unsigned long nums[2];
+	unsigned long val;
+	int n = 0;
+	char *tok;
+
+	for(tok = strtok(line, " \t\r\n,{}();="); tok != NULL; tok = strtok(NULL, " \t\r\n,{}();="))
+	{
+		if(parse_number(tok, &val))
+		{
+			if(n == 2)
+			{
+				return 0;
+			}
+			nums[n++] = val;
+		}
+	}
+	if(n != 2)
+	{
+		return 0;
+	}
+	if(nums[0] >= SI5351_REG_COUNT || nums[1] > 0xFF)
+	{
+		fprintf(stderr, "cbgen: register %lu = %lu is out of range\n", nums[0], nums[1]);
+		exit(1);
+	}
+	add_reg(nums[0], nums[1]);
+	return 1;
+}
+
+// Frequency in Hz with up to two decimal places, to Hz * 100
+static uint64_t parse_freq(const char *tok)
+{
+	uint64_t freq = 0;
+	uint8_t frac = 0;
+	int in_frac = 0;
+
+	for(; *tok != '\0'; tok++)
+	{
+		if(*tok == '.' && !in_frac)
+		{
+			in_frac = 1;
+		}
+		else if(isdigit((unsigned char)*tok) && (!in_frac || frac < 2))
+		{
+			freq = freq * 10 + (*tok - '0');
+			frac += in_frac;
+		}
+		else
+		{
+			fprintf(stderr, "cbgen: bad frequency\n");
+			exit(1);
+		}
+	}
+	for(; frac < 2; frac++)
+	{
+		freq *= 10;
+	}
+	return freq;
+}
+
+static int run_spec(FILE *in)
+{
+	CaptureBus bus;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &bus);
+	uint64_t freqs[8] = {0};
+	uint8_t use_pllb[8] = {0};
+	uint32_t xtal = 0;
+	int32_t corr = 0;
+	uint8_t load = SI5351_CRYSTAL_LOAD_8PF;
+	char line[256];
+	char *p, *key, *val, *opt;
+	int i;
+
+	while(fgets(line, sizeof(line), in) != NULL)
+	{
+		p = content(line);
+		if(p == NULL)
+		{
+			continue;
+		}
+		key = strtok(p, " \t\r\n");
+		val = strtok(NULL, " \t\r\n");
+		opt = strtok(NULL, " \t\r\n");
+		if(val == NULL)
+		{
+			fprintf(stderr, "cbgen: missing value for %s\n", key);
+			return 1;
+		}
+
+		if(strcmp(key, "xtal") == 0)
+		{
+			xtal = strtoul(val, NULL, 10);
+		}
+		else if(strcmp(key, "correction") == 0)
+		{
+			corr = strtol(val, NULL, 10);
+		}
+		else if(strcmp(key, "load") == 0)
+		{
+			switch(atoi(val))
+			{
+			case 6:
+				load = SI5351_CRYSTAL_LOAD_6PF;
+				break;
+			case 8:
+				load = SI5351_CRYSTAL_LOAD_8PF;
+				break;
+			case 10:
+				load = SI5351_CRYSTAL_LOAD_10PF;
+				break;
+			default:
+				fprintf(stderr, "cbgen: load must be 6, 8 or 10\n");
+				return 1;
+			}
+		}
+		else if(strncmp(key, "clk", 3) == 0 && key[3] >= '0' && key[3] <= '7' && key[4] == '\0')
+		{
+			i = key[3] - '0';
+			freqs[i] = parse_freq(val);
+			use_pllb[i] = (opt != NULL && strcmp(opt, "pllb") == 0) ? 1 : 0;
+		}
+		else
+		{
+			fprintf(stderr, "cbgen: unknown setting %s\n", key);
+			return 1;
+		}
+	}
+
+	si5351.init(load, xtal, corr);
+	for(i = 0; i < 8; i++)
+	{
+		if(freqs[i] == 0)
+		{
+			continue;
+		}
+		if(use_pllb[i])
+		{
+			si5351.set_ms_source((enum si5351_clock)i, SI5351_PLLB);
+		}
+		if(si5351.set_freq(freqs[i], (enum si5351_clock)i) != 0)
+		{
+			fprintf(stderr, "cbgen: clk%d cannot be set to that frequency\n", i);
+			return 1;
+		}
+	}
+
+	// Everything the library wrote, except the status and reset registers
+	for(i = 0; i < SI5351_REG_COUNT; i++)
+	{
+		if(bus.written[i] && i != SI5351_DEVICE_STATUS &&
+			i != SI5351_INTERRUPT_STATUS && i != SI5351_PLL_RESET)
+		{
+			add_reg(i, bus.image[i]);
+		}
+	}
+	return 0;
+}
+
+static int run_register_list(FILE *in)
+{
+	char line[256];
+	char *p;
+
+	while(fgets(line, sizeof(line), in) != NULL)
+	{
+		p = content(line);
+		if(p != NULL)
+		{
+			parse_register_line(p);
+		}
+	}
+	if(reg_count == 0)
+	{
+		fprintf(stderr, "cbgen: no registers found\n");
+		return 1;
+	}
+	return 0;
+}
+
+// A frequency spec starts with one of its keywords
+static int is_spec(FILE *in)
+{
+	char line[256];
+	char *p;
+	int spec = 0;
+
+	while(fgets(line, sizeof(line), in) != NULL)
+	{
+		p = content(line);
+		if(p != NULL)
+		{
+			spec = strncmp(p, "xtal", 4) == 0 || strncmp(p, "load", 4) == 0 ||
+				strncmp(p, "correction", 10) == 0 || strncmp(p, "clk", 3) == 0;
+			break;
+		}
+	}
+	rewind(in);
+	return spec;
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = "si5351_regs";
+	const char *in_name = NULL;
+	const char *out_name = NULL;
+	FILE *in, *out;
+	uint16_t i;
+	int argi;
+
+	for(argi = 1; argi < argc; argi++)
+	{
+		if(strcmp(argv[argi], "-n") == 0 && argi + 1 < argc)
+		{
+			name = argv[++argi];
+		}
+		else if(in_name == NULL)
+		{
+			in_name = argv[argi];
+		}
+		else if(out_name == NULL)
+		{
+			out_name = argv[argi];
+		}
+		else
+		{
+			in_name = NULL;
+			break;
+		}
+	}
+	if(in_name == NULL)
+	{
+		fprintf(stderr, "usage: cbgen [-n name] input [output.h]\n");
+		return 2;
+	}
+
+	in = fopen(in_name, "r");
+	if(in == NULL)
+	{
+		perror(in_name);
+		return 1;
+	}
+	if((is_spec(in) ? run_spec(in) : run_register_list(in)) != 0)
+	{
+		fclose(in);
+		return 1;
+	}
+	fclose(in);
+
+	out = (out_name != NULL) ? fopen(out_name, "w") : stdout;
+	if(out == NULL)
+	{
+		perror(out_name);
+		return 1;
+	}
+
+	fprintf(out, "/* Generated by cbgen from %s */\n\n", in_name);
+	fprintf(out, "#include <si5351.h>\n\n");
+	fprintf(out, "const struct Si5351RegValue %s[] PROGMEM = {", name);
+	for(i = 0; i < reg_count; i++)
+	{
+		fprintf(out, "%s{%u, 0x%02X}", (i % 6 == 0) ? "\n  " : " ", reg_addr[i], reg_value[i]);
+		if(i + 1 < reg_count)
+		{
+			fputc(',', out);
+		}
+	}
+	fprintf(out, "\n};\n\n");
+	fprintf(out, "const uint16_t %s_count = %u;\n", name, reg_count);
+
+	if(out != stdout)
+	{
+		fclose(out);
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Arduino.h - Minimal host stand-in so that the library can be built
+ * into host programs such as cbgen and the simulator
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SI5351_HOST_ARDUINO_H_
+#define SI5351_HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+/*
+ * Time base. With no hardware to wait for, time only moves forward: by
+ * 1 us per call to micros(), and by the time given to delay() and
+ * delayMicroseconds(). A host model of the hardware (such as Si5351Sim)
+ * can take the time base over by installing itself as host_clock(), so
+ * that the library sees the same time as the model.
+ */
+class HostClock
+{
+public:
+	virtual uint64_t get_time(void) = 0;
+	virtual void advance(uint32_t) = 0;
+};
+
+inline HostClock *&host_clock(void)
+{
+	static HostClock *clock = NULL;
+	return clock;
+}
+
+inline unsigned long micros(void)
+{
+	static unsigned long t = 0;
+
+	if(host_clock() != NULL)
+	{
+		host_clock()->advance(1);
+		return (unsigned long)host_clock()->get_time();
+	}
+	return ++t;
+}
+
+inline unsigned long millis(void)
+{
+	return micros() / 1000;
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+	if(host_clock() != NULL)
+	{
+		host_clock()->advance(us);
+	}
+}
+
+inline void delay(unsigned long ms)
+{
+	if(host_clock() != NULL)
+	{
+		host_clock()->advance(ms * 1000);
+	}
+}
+
+#endif
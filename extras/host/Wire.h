@@ -0,0 +1,40 @@
+/*
+ * Wire.h - Minimal host stand-in so that the library can be built into
+ * host programs. These give the library their own Si5351Bus (such as
+ * Si5351Sim), so none of this is ever called.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SI5351_HOST_WIRE_H_
+#define SI5351_HOST_WIRE_H_
+
+#include "Arduino.h"
+
+class TwoWire
+{
+public:
+	void begin(void) {}
+	void setClock(uint32_t) {}
+	void beginTransmission(uint8_t) {}
+	size_t write(uint8_t) { return 1; }
+	uint8_t endTransmission(uint8_t = 1) { return 0; }
+	uint8_t requestFrom(uint8_t, uint8_t, uint8_t = 1) { return 0; }
+	int available(void) { return 0; }
+	int read(void) { return 0; }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,451 @@
+/*
+ * si5351_sim.cpp - Register-level host model of the Si5351
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "si5351_sim.h"
+
+Si5351Sim::Si5351Sim(uint8_t i2c_addr):
+	transactions(0),
+	bytes_written(0),
+	bytes_read(0),
+	reads(0),
+	addr(i2c_addr),
+	bus_clock(SI5351_SIM_BUS_CLOCK),
+	xtal_freq(SI5351_XTAL_FREQ),
+	clkin_freq(0),
+	lol_time(SI5351_SIM_LOL_TIME),
+	now_us(0)
+{
+	power_on();
+	host_clock() = this;
+}
+
+Si5351Sim::~Si5351Sim()
+{
+	if(host_clock() == this)
+	{
+		host_clock() = NULL;
+	}
+}
+
+/*
+ * Si5351Bus interface
+ *
+ * Each transaction moves the simulated time on by as long as it would
+ * take on the bus at the clock given to set_clock(). A transaction to
+ * any other address is not acknowledged (Wire status 2).
+ */
+void Si5351Sim::begin(void)
+{
+}
+
+void Si5351Sim::set_clock(uint32_t speed)
+{
+	bus_clock = speed;
+}
+
+uint8_t Si5351Sim::probe(uint8_t i2c_addr)
+{
+	transactions++;
+	bus_time(1);
+	return (i2c_addr == addr) ? 0 : 2;
+}
+
+uint8_t Si5351Sim::write(uint8_t i2c_addr, uint8_t reg_addr, const uint8_t *data, uint8_t bytes)
+{
+	uint8_t reg;
+
+	transactions++;
+	if(i2c_addr != addr)
+	{
+		bus_time(1);
+		return 2;
+	}
+	bus_time(bytes + 2);
+	bytes_written += bytes;
+
+	for(uint8_t i = 0; i < bytes; i++)
+	{
+		reg = reg_addr + i;
+		if(reg >= SI5351_REG_COUNT || reg == SI5351_DEVICE_STATUS)
+		{
+			continue;
+		}
+
+		if(reg == SI5351_INTERRUPT_STATUS)
+		{
+			// Sticky bits are cleared by writing 0 to them
+			regs[reg] &= data[i];
+		}
+		else if(reg == SI5351_PLL_RESET)
+		{
+			// Self-clearing; the PLL is out of lock for lol_time from here
+			if(data[i] & SI5351_PLL_RESET_A)
+			{
+				lock_at[SI5351_PLLA] = now_us + lol_time;
+			}
+			if(data[i] & SI5351_PLL_RESET_B)
+			{
+				lock_at[SI5351_PLLB] = now_us + lol_time;
+			}
+		}
+		else
+		{
+			regs[reg] = data[i];
+		}
+	}
+
+	update_status();
+	return 0;
+}
+
+uint8_t Si5351Sim::write_read(uint8_t i2c_addr, uint8_t reg_addr, uint8_t *data, uint8_t bytes)
+{
+	uint8_t reg;
+
+	transactions++;
+	if(i2c_addr != addr)
+	{
+		bus_time(1);
+		return 2;
+	}
+	// Register address write, then a repeated start and the read
+	bus_time(bytes + 3);
+	bytes_read += bytes;
+	reads++;
+
+	update_status();
+	for(uint8_t i = 0; i < bytes; i++)
+	{
+		reg = reg_addr + i;
+		data[i] = (reg < SI5351_REG_COUNT) ? regs[reg] : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * power_on(void)
+ *
+ * Start over as a freshly powered chip: every register is 0 (so both
+ * PLLs are out of lock until they are set up) and the simulated time is
+ * left where it is.
+ */
+void Si5351Sim::power_on(void)
+{
+	memset(regs, 0, sizeof(regs));
+	lock_at[SI5351_PLLA] = 0;
+	lock_at[SI5351_PLLB] = 0;
+	update_status();
+}
+
+/*
+ * set_ref_freq(uint32_t xtal, uint32_t clkin)
+ *
+ * xtal - Frequency of the crystal in Hz, or 0 for none
+ * clkin - Frequency on the CLKIN pin in Hz, or 0 for none
+ *
+ * A missing reference shows as LOS_XTAL or LOS in the status register,
+ * and any PLL running from it is out of lock.
+ */
+void Si5351Sim::set_ref_freq(uint32_t xtal, uint32_t clkin)
+{
+	xtal_freq = xtal;
+	clkin_freq = clkin;
+	update_status();
+}
+
+/*
+ * set_lol_time(uint32_t lol_us)
+ *
+ * lol_us - Time in microseconds that a PLL stays out of lock after it
+ *   has been reset through register 177
+ */
+void Si5351Sim::set_lol_time(uint32_t lol_us)
+{
+	lol_time = lol_us;
+}
+
+/*
+ * advance(uint32_t us)
+ *
+ * Move the simulated time on, e.g. for a delay() in the code under test.
+ */
+void Si5351Sim::advance(uint32_t us)
+{
+	now_us += us;
+	update_status();
+}
+
+/*
+ * get_time(void)
+ *
+ * Returns the simulated time in microseconds, which includes the time
+ * all bus transactions so far would have taken.
+ */
+uint64_t Si5351Sim::get_time(void)
+{
+	return now_us;
+}
+
+/*
+ * pll_locked(enum si5351_pll target_pll)
+ *
+ * Returns 1 if the PLL has a reference, its VCO is in range and any
+ * reset has finished, else 0.
+ */
+uint8_t Si5351Sim::pll_locked(enum si5351_pll target_pll)
+{
+	return pll_status(target_pll);
+}
+
+/*
+ * get_pll_freq(enum si5351_pll target_pll)
+ *
+ * Returns the VCO frequency in Hz that the feedback Multisynth registers
+ * (26 to 41) and the PLL input source work out to, or 0 if they are not
+ * set up.
+ */
+double Si5351Sim::get_pll_freq(enum si5351_pll target_pll)
+{
+	uint8_t base = (target_pll == SI5351_PLLA) ? SI5351_PLLA_PARAMETERS : SI5351_PLLB_PARAMETERS;
+
+	return pll_ref_freq(target_pll) * ms_ratio(&regs[base], NULL);
+}
+
+/*
+ * get_output(enum si5351_clock clk, struct Si5351SimOutput *out)
+ *
+ * Decode everything the registers say about an output: its CLKx_CTRL
+ * register, the output enable, its Multisynth divider including R,
+ * DIVBY4 and integer mode, and its phase offset.
+ */
+void Si5351Sim::get_output(enum si5351_clock clk, struct Si5351SimOutput *out)
+{
+	uint8_t ctrl = regs[SI5351_CLK0_CTRL + (uint8_t)clk];
+	uint8_t ms = (uint8_t)clk;
+	uint8_t integer = 1;
+	uint8_t ms_used, ms_ctrl, div;
+	const uint8_t *params;
+	double vco = 0;
+	double freq;
+
+	out->enabled = (regs[SI5351_OUTPUT_ENABLE_CTRL] & (1 << (uint8_t)clk)) ? 0 : 1;
+	out->powered = (ctrl & SI5351_CLK_POWERDOWN) ? 0 : 1;
+	out->inverted = (ctrl & SI5351_CLK_INVERT) ? 1 : 0;
+	out->source = (enum si5351_clock_source)((ctrl & SI5351_CLK_INPUT_MASK) >> 2);
+	out->phase_offset = ((uint8_t)clk <= (uint8_t)SI5351_CLK5) ? (regs[SI5351_CLK0_PHASE_OFFSET + (uint8_t)clk] & 0x7F) : 0;
+	out->valid = 1;
+
+	// With XTAL or CLKIN as the source, the Multisynth is bypassed and its
+	// settings do not matter
+	ms_used = (out->source == SI5351_CLK_SRC_MS0 || out->source == SI5351_CLK_SRC_MS) ? 1 : 0;
+
+	// Fanout from MS0 or MS4, whose own control register picks the PLL
+	if(out->source == SI5351_CLK_SRC_MS0)
+	{
+		ms = ((uint8_t)clk < 4) ? 0 : 4;
+	}
+	ms_ctrl = regs[SI5351_CLK0_CTRL + ms];
+	out->pll = (ms_ctrl & SI5351_CLK_PLL_SELECT) ? SI5351_PLLB : SI5351_PLLA;
+	out->int_mode = (ms_ctrl & SI5351_CLK_INTEGER_MODE) ? 1 : 0;
+
+	if(ms <= 5)
+	{
+		params = &regs[SI5351_CLK0_PARAMETERS + (ms * 8)];
+		out->r_div = (params[2] & SI5351_OUTPUT_CLK_DIV_MASK) >> SI5351_OUTPUT_CLK_DIV_SHIFT;
+		out->divby4 = ((params[2] & SI5351_OUTPUT_CLK_DIVBY4) == SI5351_OUTPUT_CLK_DIVBY4) ? 1 : 0;
+		if(out->divby4)
+		{
+			out->ms_div = 4;
+		}
+		else
+		{
+			out->ms_div = ms_ratio(params, &integer);
+			if(ms_used && (out->ms_div < SI5351_MULTISYNTH_A_MIN || out->ms_div > SI5351_MULTISYNTH_A_MAX ||
+				(out->int_mode && !integer)))
+			{
+				out->valid = 0;
+			}
+		}
+	}
+	else
+	{
+		// MS6 and MS7 are even integer dividers only
+		div = regs[SI5351_CLK6_PARAMETERS + (ms - 6)];
+		out->r_div = (ms == 6) ? (regs[SI5351_CLK6_7_OUTPUT_DIVIDER] & SI5351_OUTPUT_CLK6_DIV_MASK) :
+			((regs[SI5351_CLK6_7_OUTPUT_DIVIDER] & SI5351_OUTPUT_CLK_DIV_MASK) >> SI5351_OUTPUT_CLK_DIV_SHIFT);
+		out->divby4 = 0;
+		out->ms_div = div;
+		if(ms_used && (div < SI5351_MULTISYNTH_A_MIN || div > SI5351_MULTISYNTH67_A_MAX || (div & 1)))
+		{
+			out->valid = 0;
+		}
+	}
+
+	switch(out->source)
+	{
+	case SI5351_CLK_SRC_XTAL:
+		freq = xtal_freq;
+		break;
+	case SI5351_CLK_SRC_CLKIN:
+		freq = clkin_freq;
+		break;
+	default:
+		vco = get_pll_freq(out->pll);
+		if(vco < SI5351_PLL_VCO_MIN || vco > SI5351_PLL_VCO_MAX)
+		{
+			out->valid = 0;
+		}
+		freq = (out->ms_div > 0) ? vco / out->ms_div : 0;
+		break;
+	}
+	freq /= (double)(1 << out->r_div);
+
+	// The offset is in quarter periods of the VCO, i.e. a delay in time
+	out->phase = out->inverted ? 180 : 0;
+	if(vco > 0)
+	{
+		out->phase += 360.0 * freq * out->phase_offset / (4.0 * vco);
+	}
+	out->phase = fmod(out->phase, 360.0);
+
+	if(!out->enabled || !out->powered ||
+		(ms_used && !pll_status(out->pll)))
+	{
+		freq = 0;
+	}
+	out->freq = freq;
+}
+
+/*
+ * get_freq(enum si5351_clock clk)
+ *
+ * Returns the frequency in Hz on an output pin, or 0 if it is off.
+ */
+double Si5351Sim::get_freq(enum si5351_clock clk)
+{
+	struct Si5351SimOutput out;
+
+	get_output(clk, &out);
+	return out.freq;
+}
+
+/*
+ * get_phase(enum si5351_clock clk)
+ *
+ * Returns the phase of an output in degrees, relative to an output on
+ * the same PLL with no phase offset and no inversion.
+ */
+double Si5351Sim::get_phase(enum si5351_clock clk)
+{
+	struct Si5351SimOutput out;
+
+	get_output(clk, &out);
+	return out.phase;
+}
+
+/*********************************************************/
+/************************ Private ************************/
+/*********************************************************/
+
+double Si5351Sim::pll_ref_freq(enum si5351_pll target_pll)
+{
+	uint8_t src = regs[SI5351_PLL_INPUT_SOURCE];
+	uint8_t mask = (target_pll == SI5351_PLLA) ? SI5351_PLLA_SOURCE : SI5351_PLLB_SOURCE;
+
+	if(src & mask)
+	{
+		return (double)clkin_freq / (1 << ((src & SI5351_CLKIN_DIV_MASK) >> 6));
+	}
+	return xtal_freq;
+}
+
+/*
+ * Divide ratio (P1 + 512 + P2 / P3) / 128 of a packed parameter set,
+ * the inverse of pack_params(). integer is set to whether the ratio is
+ * a whole number. Returns 0 if P3 is 0.
+ */
+double Si5351Sim::ms_ratio(const uint8_t *params, uint8_t *integer)
+{
+	uint32_t p1 = ((uint32_t)(params[2] & 0x03) << 16) | ((uint32_t)params[3] << 8) | params[4];
+	uint32_t p2 = ((uint32_t)(params[5] & 0x0F) << 16) | ((uint32_t)params[6] << 8) | params[7];
+	uint32_t p3 = ((uint32_t)(params[5] & 0xF0) << 12) | ((uint32_t)params[0] << 8) | params[1];
+	uint64_t num;
+
+	if(p3 == 0)
+	{
+		return 0;
+	}
+
+	num = (uint64_t)(p1 + 512) * p3 + p2;
+	if(integer != NULL)
+	{
+		*integer = (num % (128ULL * p3) == 0) ? 1 : 0;
+	}
+	return (double)num / (128.0 * p3);
+}
+
+uint8_t Si5351Sim::pll_status(enum si5351_pll target_pll)
+{
+	double vco = get_pll_freq(target_pll);
+
+	if(vco < SI5351_PLL_VCO_MIN || vco > SI5351_PLL_VCO_MAX)
+	{
+		return 0;
+	}
+	return (now_us >= lock_at[target_pll]) ? 1 : 0;
+}
+
+/*
+ * Work out register 0 from the present state, and latch any alarm into
+ * the sticky bits of register 1.
+ */
+void Si5351Sim::update_status(void)
+{
+	uint8_t status = SI5351_SIM_REVID;
+
+	if(!pll_status(SI5351_PLLA))
+	{
+		status |= SI5351_STATUS_LOL_A;
+	}
+	if(!pll_status(SI5351_PLLB))
+	{
+		status |= SI5351_STATUS_LOL_B;
+	}
+	if(clkin_freq == 0 && (regs[SI5351_PLL_INPUT_SOURCE] & (SI5351_PLLA_SOURCE | SI5351_PLLB_SOURCE)))
+	{
+		status |= SI5351_STATUS_LOS;
+	}
+	if(xtal_freq == 0)
+	{
+		status |= SI5351_STATUS_LOS_XTAL;
+	}
+
+	regs[SI5351_DEVICE_STATUS] = status;
+	regs[SI5351_INTERRUPT_STATUS] |= status & SI5351_EVENT_ALL;
+}
+
+// Start and stop conditions, and 9 clocks per byte with its ACK
+void Si5351Sim::bus_time(uint16_t bytes)
+{
+	uint32_t bits = (uint32_t)bytes * 9 + 2;
+
+	now_us += ((uint64_t)bits * 1000000UL + bus_clock - 1) / bus_clock;
+}
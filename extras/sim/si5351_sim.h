@@ -0,0 +1,114 @@
+/*
+ * si5351_sim.h - Register-level host model of the Si5351
+ *
+ * Si5351Sim is an Si5351Bus that answers the library's I2C transactions
+ * from a model of the chip instead of real hardware. It holds the
+ * register map and works out the frequency and phase of every output
+ * from the registers alone, so a host program can check that what the
+ * library writes really gives the frequency that was asked for.
+ *
+ * This is a host file, not part of the Arduino library. Build it along
+ * with the library from the root of the library, e.g.:
+ *
+ *   g++ -std=c++11 -O2 -Iextras/host -Iextras/sim -Isrc \
+ *     my_check.cpp extras/sim/si5351_sim.cpp src/si5351.cpp -o my_check
+ *
+ * The model keeps the time for the whole program: while an Si5351Sim
+ * exists, micros(), delay() and delayMicroseconds() from extras/host
+ * read and move on its clock, so timeouts and lock times measured by the
+ * library are in simulated time.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SI5351_SIM_H_
+#define SI5351_SIM_H_
+
+#include "si5351.h"
+
+/* Define definitions */
+
+#define SI5351_SIM_LOL_TIME             1000
+#define SI5351_SIM_BUS_CLOCK            100000
+#define SI5351_SIM_REVID                1
+
+/* Struct definitions */
+
+/*
+ * Everything the registers say about one output. freq and phase are
+ * what the pin would show: freq is 0 while the output is powered down,
+ * disabled, or its PLL is out of lock. valid is 0 if the registers hold
+ * a setting the chip does not support (VCO or divider out of range, or
+ * integer mode set on a fractional divider), in which case freq is
+ * still the one the registers work out to. The Multisynth and PLL are
+ * only checked when the output is driven from a Multisynth.
+ */
+struct Si5351SimOutput
+{
+	uint8_t enabled;
+	uint8_t powered;
+	enum si5351_clock_source source;
+	enum si5351_pll pll;
+	uint8_t int_mode;
+	uint8_t divby4;
+	uint8_t r_div;
+	uint8_t inverted;
+	uint8_t phase_offset;
+	uint8_t valid;
+	double ms_div;
+	double freq;
+	double phase;
+};
+
+class Si5351Sim : public Si5351Bus, public HostClock
+{
+public:
+	Si5351Sim(uint8_t i2c_addr = SI5351_BUS_BASE_ADDR);
+	~Si5351Sim();
+	void begin(void);
+	void set_clock(uint32_t);
+	uint8_t probe(uint8_t);
+	uint8_t write(uint8_t, uint8_t, const uint8_t *, uint8_t);
+	uint8_t write_read(uint8_t, uint8_t, uint8_t *, uint8_t);
+	void power_on(void);
+	void set_ref_freq(uint32_t, uint32_t);
+	void set_lol_time(uint32_t);
+	void advance(uint32_t);
+	uint64_t get_time(void);
+	uint8_t pll_locked(enum si5351_pll);
+	double get_pll_freq(enum si5351_pll);
+	void get_output(enum si5351_clock, struct Si5351SimOutput *);
+	double get_freq(enum si5351_clock);
+	double get_phase(enum si5351_clock);
+	uint8_t regs[SI5351_REG_COUNT];
+	uint32_t transactions;
+	uint32_t bytes_written;
+	uint32_t bytes_read;
+	uint32_t reads;
+private:
+	double pll_ref_freq(enum si5351_pll);
+	double ms_ratio(const uint8_t *, uint8_t *);
+	uint8_t pll_status(enum si5351_pll);
+	void update_status(void);
+	void bus_time(uint16_t);
+	uint8_t addr;
+	uint32_t bus_clock;
+	uint32_t xtal_freq;
+	uint32_t clkin_freq;
+	uint32_t lol_time;
+	uint64_t now_us;
+	uint64_t lock_at[2];
+};
+
+#endif /* SI5351_SIM_H_ */
@@ -0,0 +1,102 @@
+/*
+ * eventcheck.cpp - Check that service_events() neither loses nor
+ *   invents events
+ *
+ * This is a host program, not an Arduino sketch. service_events() reads
+ * the sticky flags in register 1 and then clears them. A flag that the
+ * chip latches between that read and the write has to stay set, so that
+ * the next call reports it. This program runs it on a Si5351Sim chip
+ * model that latches loss of signal right after the status read. It
+ * also checks that the callback of an event masked off with
+ * enable_events() is not called.
+ *
+ * Build and run it with "make -C extras event-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+// A chip model that latches a new event just after a status read
+class LateEventSim : public Si5351Sim
+{
+public:
+	uint8_t late_event = 0;
+
+	uint8_t write_read(uint8_t i2c_addr, uint8_t reg_addr, uint8_t *data, uint8_t bytes)
+	{
+		uint8_t ret = Si5351Sim::write_read(i2c_addr, reg_addr, data, bytes);
+
+		regs[SI5351_INTERRUPT_STATUS] |= late_event;
+		late_event = 0;
+		return ret;
+	}
+};
+
+static uint8_t calls[SI5351_EVENT_COUNT];
+static int failed = 0;
+
+static void on_los(uint8_t) { calls[3]++; }
+static void on_lol_a(uint8_t) { calls[2]++; }
+static void on_lol_b(uint8_t) { calls[1]++; }
+
+static void expect(const char *what, uint8_t got, uint8_t want)
+{
+	if(got != want)
+	{
+		fprintf(stderr, "eventcheck: %s is 0x%02X, expected 0x%02X\n", what, got, want);
+		failed = 1;
+	}
+}
+
+int main(void)
+{
+	LateEventSim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	chip.advance(10000);
+	si5351.set_event_callback(SI5351_STATUS_LOS, on_los);
+	si5351.set_event_callback(SI5351_STATUS_LOL_A, on_lol_a);
+	si5351.set_event_callback(SI5351_STATUS_LOL_B, on_lol_b);
+	si5351.enable_events(SI5351_STATUS_LOL_A | SI5351_STATUS_LOS);
+
+	// Loss of lock on PLL A, and loss of signal just after the read
+	chip.regs[SI5351_INTERRUPT_STATUS] = SI5351_STATUS_LOL_A;
+	chip.late_event = SI5351_STATUS_LOS;
+	si5351.int_notify();
+	expect("the first service_events()", si5351.service_events(), SI5351_STATUS_LOL_A);
+	expect("register 1 after it", chip.regs[SI5351_INTERRUPT_STATUS] & SI5351_EVENT_ALL, SI5351_STATUS_LOS);
+
+	si5351.int_notify();
+	expect("the second service_events()", si5351.service_events(), SI5351_STATUS_LOS);
+	expect("register 1 after it", chip.regs[SI5351_INTERRUPT_STATUS] & SI5351_EVENT_ALL, 0);
+
+	// Loss of lock on PLL B is masked off, so it is only cleared
+	chip.regs[SI5351_INTERRUPT_STATUS] = SI5351_STATUS_LOL_B;
+	si5351.int_notify();
+	expect("a masked service_events()", si5351.service_events(), 0);
+	expect("register 1 after it", chip.regs[SI5351_INTERRUPT_STATUS] & SI5351_EVENT_ALL, 0);
+
+	expect("LOS callbacks", calls[3], 1);
+	expect("LOL_A callbacks", calls[2], 1);
+	expect("LOL_B callbacks", calls[1], 0);
+
+	fprintf(stderr, "eventcheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
@@ -0,0 +1,110 @@
+/*
+ * finecheck.cpp - Check the result that set_freq_fine() reports
+ *
+ * This is a host program, not an Arduino sketch. set_freq_fine() reports
+ * the frequency it achieved and its error in 1 uHz units. That has to
+ * be what the output really does, including any error of a fractional
+ * PLL. This program gives the library a crystal frequency and a
+ * correction, and runs the Si5351Sim chip model from the crystal
+ * frequency that the correction describes. Each call to set_freq_fine()
+ * then has to report the same frequency the model puts out.
+ *
+ * Build and run it with "make -C extras fine-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+// Allowed difference between the reported and the simulated output, as
+// a fraction of the output frequency. The library only knows the
+// corrected reference to about 0.01 Hz, a few parts in 10^10.
+#define FINE_TOLERANCE 1e-9
+
+struct fine_ref
+{
+	uint32_t xtal;
+	int32_t corr;
+	uint32_t real_xtal;
+};
+
+// Each correction is an exact number of Hz on the crystal
+static const struct fine_ref refs[] =
+{
+	{25000000, 0, 25000000},
+	{25000000, 125000, 25003125},
+	{25000000, -40000, 24999000},
+	{27000000, 2000000, 27054000}
+};
+
+static const uint64_t fine_freqs[] =
+{
+	14076123333333ULL,    // 14.076123333333 MHz
+	7074000000000ULL,     // 7.074 MHz
+	10000000000000ULL,    // 10 MHz
+	137500123456ULL,      // 137.500123456 kHz
+	99999999999999ULL     // Just under 100 MHz
+};
+
+static int failed = 0;
+
+static void check(const struct fine_ref *ref, uint64_t freq)
+{
+	Si5351Sim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	struct Si5351FreqResult result;
+	double real, reported;
+
+	chip.set_ref_freq(ref->real_xtal, 0);
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, ref->xtal, ref->corr);
+	chip.advance(10000);
+
+	if(si5351.set_freq_fine(freq, SI5351_CLK0, &result) != 0)
+	{
+		fprintf(stderr, "finecheck: %llu uHz with correction %ld failed\n",
+			(unsigned long long)freq, (long)ref->corr);
+		failed = 1;
+		return;
+	}
+
+	real = chip.get_freq(SI5351_CLK0);
+	reported = (double)result.achieved / SI5351_FINE_FREQ_MULT;
+	if(fabs(real - reported) > real * FINE_TOLERANCE ||
+		(int64_t)(result.achieved - freq) != result.error)
+	{
+		fprintf(stderr, "finecheck: %llu uHz with correction %ld: the output is %.6f Hz, "
+			"set_freq_fine() reports %.6f Hz (error %lld uHz)\n", (unsigned long long)freq,
+			(long)ref->corr, real, reported, (long long)result.error);
+		failed = 1;
+	}
+}
+
+int main(void)
+{
+	for(uint8_t i = 0; i < sizeof(refs) / sizeof(refs[0]); i++)
+	{
+		for(uint8_t j = 0; j < sizeof(fine_freqs) / sizeof(fine_freqs[0]); j++)
+		{
+			check(&refs[i], fine_freqs[j]);
+		}
+	}
+
+	fprintf(stderr, "finecheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
@@ -0,0 +1,133 @@
+/*
+ * heapcheck.cpp - Check that the library never allocates from the heap
+ *
+ * This is a host program, not an Arduino sketch. The library and the
+ * Si5351Sim chip model are built with SI5351_NO_HEAP, which has the
+ * compiler reject new, delete, malloc() and friends in si5351.cpp. That
+ * does not catch a heap allocation hidden in a header or a library
+ * call, so this program also replaces operator new and operator new[]
+ * with versions that abort once the objects have been constructed, and
+ * then runs the main entry points: init(), set_freq(), set_pll(),
+ * set_ms(), set_vcxo(), a transaction, a sweep, a frequency list and
+ * symbol playback.
+ *
+ * Build and run it with "make -C extras heap-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+static volatile int heap_armed = 0;
+
+static void *heap_alloc(size_t size)
+{
+	void *p;
+
+	if(heap_armed)
+	{
+		fprintf(stderr, "heapcheck: heap allocation of %lu bytes\n", (unsigned long)size);
+		fprintf(stderr, "heapcheck: FAIL\n");
+		abort();
+	}
+
+	p = malloc(size ? size : 1);
+	if(p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new(size_t size)
+{
+	return heap_alloc(size);
+}
+
+void *operator new[](size_t size)
+{
+	return heap_alloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+static const uint64_t list_freqs[] =
+{
+	1407600000ULL,    // 14.076 MHz
+	1407610000ULL,
+	1407620000ULL,
+	1407630000ULL
+};
+
+int main(void)
+{
+	Si5351Sim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	struct Si5351FreqStep steps[sizeof(list_freqs) / sizeof(list_freqs[0])];
+	struct Si5351Sweep sweep;
+	struct Si5351Symbols sym;
+	struct Si5351FreqStep tones[2];
+	const uint8_t symbols[4] = {0, 1, 1, 0};
+	struct Si5351RegSet ms_reg = {128 * 36 - 512, 0, 1};
+	uint16_t count;
+
+	heap_armed = 1;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	si5351.set_freq(1000000000ULL, SI5351_CLK0);
+	si5351.set_freq(11250000000ULL, SI5351_CLK7);
+	si5351.set_pll(SI5351_PLL_FIXED, SI5351_PLLB);
+	si5351.set_ms(SI5351_CLK2, ms_reg, 1, SI5351_OUTPUT_CLK_DIV_1, 0);
+	si5351.set_vcxo(87500000000ULL, 30);
+
+	si5351.begin_transaction();
+	si5351.set_freq(700000000ULL, SI5351_CLK1);
+	si5351.set_freq(1400000000ULL, SI5351_CLK3);
+	si5351.commit();
+
+	if(si5351.start_sweep(&sweep, SI5351_CLK0, 100000000ULL, 3000000000ULL, 100, SI5351_SWEEP_LOG) == 0)
+	{
+		while(si5351.sweep_step(&sweep))
+		{
+		}
+	}
+
+	count = si5351.compile_freq_list(SI5351_CLK4, list_freqs, sizeof(list_freqs) / sizeof(list_freqs[0]), steps);
+	si5351.play_freq_list(SI5351_CLK4, steps, count, NULL);
+
+	si5351.compile_tones(SI5351_CLK5, 1407600000ULL, 146, 2, tones);
+	si5351.start_symbols(&sym, SI5351_CLK5, tones, symbols, sizeof(symbols), 1000000UL);
+	while(si5351.symbol_tick(&sym))
+	{
+	}
+
+	heap_armed = 0;
+
+	fprintf(stderr, "heapcheck: PASS\n");
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * phasedcheck.cpp - Check set_freq_phased() at the edges of its range
+ *
+ * This is a host program, not an Arduino sketch. set_freq_phased() runs
+ * the Multisynth of each output in integer mode, with an even divider of
+ * at most SI5351_MULTISYNTH_A_MAX and without DIVBY4. That limits it to
+ * 500 kHz up to just under 150 MHz, and the largest divider alone would
+ * stop it at about 333.33 kHz. This program asks for frequencies on both
+ * sides of these limits, and for a few ordinary ones, on the Si5351Sim
+ * chip model. Every call that succeeds has to leave the outputs valid,
+ * on frequency and at the right phase. Every call outside the range has
+ * to fail without writing anything. Last, retune_phased() has to keep
+ * clk_freq[] right for another output on the same PLL.
+ *
+ * Build and run it with "make -C extras phased-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+// The lowest frequency in Hz * 100 that the largest divider allows
+#define PHASED_A_MAX_FREQ ((SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT + SI5351_MULTISYNTH_A_MAX - 1) / SI5351_MULTISYNTH_A_MAX)
+
+struct phased_case
+{
+	uint64_t freq;
+	uint16_t phase;
+	uint8_t result;
+};
+
+static const struct phased_case cases[] =
+{
+	{915000ULL, 180, 1},                 // 9.15 kHz
+	{1000000ULL, 90, 1},                 // 10 kHz
+	{PHASED_A_MAX_FREQ - 1, 180, 1},
+	{PHASED_A_MAX_FREQ, 180, 1},
+	{49999999ULL, 180, 1},               // Just under 500 kHz
+	{50000000ULL, 180, 0},               // 500 kHz
+	{50000000ULL, 90, 1},                // 90 degrees needs too large an offset here
+	{300000000ULL, 45, 0},               // 3 MHz
+	{1410000000ULL, 90, 0},              // 14.1 MHz
+	{1410000000ULL, 270, 0},
+	{5000000000ULL, 45, 0},              // 50 MHz
+	{14999999999ULL, 180, 0},            // Just under 150 MHz
+	{15000000000ULL, 180, 1}             // 150 MHz, which needs DIVBY4
+};
+
+static int failed = 0;
+
+static void fail(const struct phased_case *c, const char *why)
+{
+	fprintf(stderr, "phasedcheck: %.2f Hz at %u degrees: %s\n", (double)c->freq / SI5351_FREQ_MULT,
+		c->phase, why);
+	failed = 1;
+}
+
+static void check(const struct phased_case *c)
+{
+	Si5351Sim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	enum si5351_clock clocks[2] = {SI5351_CLK0, SI5351_CLK1};
+	uint16_t phases[2] = {0, c->phase};
+	struct Si5351SimOutput out;
+	uint32_t written;
+	double want, phase;
+	uint8_t result, i;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	written = chip.bytes_written;
+
+	result = si5351.set_freq_phased(c->freq, clocks, phases, 2);
+	if(result != c->result)
+	{
+		fail(c, result ? "failed" : "did not fail");
+		return;
+	}
+	if(result != 0)
+	{
+		if(chip.bytes_written != written)
+		{
+			fail(c, "failed but wrote to the chip");
+		}
+		return;
+	}
+
+	chip.advance(10000);
+	want = (double)c->freq / SI5351_FREQ_MULT;
+	for(i = 0; i < 2; i++)
+	{
+		chip.get_output(clocks[i], &out);
+		if(!out.valid || !out.int_mode)
+		{
+			fail(c, "left an output without a valid integer divider");
+		}
+		// Within one step of the PLL feedback divider
+		if(fabs(out.freq - want) * out.ms_div > (double)SI5351_XTAL_FREQ / RFRAC_DENOM)
+		{
+			fail(c, "left an output off frequency");
+		}
+	}
+
+	phase = chip.get_phase(SI5351_CLK1) - chip.get_phase(SI5351_CLK0);
+	phase = fmod(phase + 720.0, 360.0);
+	if(fabs(phase - c->phase) > 1e-6)
+	{
+		fail(c, "left the wrong phase offset");
+	}
+}
+
+// CLK2 shares PLL A with a phased pair that is then retuned
+static void check_retune(void)
+{
+	Si5351Sim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	enum si5351_clock clocks[2] = {SI5351_CLK0, SI5351_CLK1};
+	uint16_t phases[2] = {0, 90};
+	double real;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	si5351.set_freq(1000000000ULL, SI5351_CLK2);
+	if(si5351.set_freq_phased(1410000000ULL, clocks, phases, 2) != 0 ||
+		si5351.retune_phased(1420000000ULL) != 0)
+	{
+		fprintf(stderr, "phasedcheck: retune_phased() failed\n");
+		failed = 1;
+		return;
+	}
+
+	chip.advance(10000);
+	real = chip.get_freq(SI5351_CLK2);
+	if(fabs((double)si5351.clk_freq[SI5351_CLK2] / SI5351_FREQ_MULT - real) > 0.01)
+	{
+		fprintf(stderr, "phasedcheck: after retune_phased(), CLK2 is at %.2f Hz but clk_freq says %.2f Hz\n",
+			real, (double)si5351.clk_freq[SI5351_CLK2] / SI5351_FREQ_MULT);
+		failed = 1;
+	}
+}
+
+int main(void)
+{
+	for(uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		check(&cases[i]);
+	}
+	check_retune();
+
+	fprintf(stderr, "phasedcheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
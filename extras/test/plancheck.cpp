@@ -0,0 +1,127 @@
+/*
+ * plancheck.cpp - Check Si5351::plan() against set_freq()
+ *
+ * This is a host program, not an Arduino sketch. Si5351::plan() redoes
+ * the frequency math of set_freq() at compile time, so the two have to
+ * be kept in step by hand. For every frequency in the table below, on
+ * every output and with several frequency corrections, this program
+ * sets up one Si5351Sim chip model with init() and set_freq() and
+ * another with init() and load_plan(), then compares the two register
+ * maps. Only register 0, the device status, is left out.
+ *
+ * Build and run it with "make -C extras plan-check". It prints each
+ * register that differs and exits non-zero if any do.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+#define XTAL_FREQ 25000000
+
+static uint16_t cases = 0;
+static uint16_t failed = 0;
+
+static void compare(uint64_t freq, enum si5351_clock clk, int32_t corr,
+	const struct Si5351ConstPlan *plan)
+{
+	Si5351Sim run_chip, plan_chip;
+	Si5351 run(SI5351_BUS_BASE_ADDR, &run_chip);
+	Si5351 fixed(SI5351_BUS_BASE_ADDR, &plan_chip);
+	uint8_t differs = 0;
+
+	run.init(SI5351_CRYSTAL_LOAD_8PF, XTAL_FREQ, corr);
+	run.set_freq(freq, clk);
+
+	fixed.init(SI5351_CRYSTAL_LOAD_8PF, XTAL_FREQ, corr);
+	fixed.load_plan(plan);
+
+	for(uint16_t reg = 1; reg < SI5351_REG_COUNT; reg++)
+	{
+		if(run_chip.regs[reg] != plan_chip.regs[reg])
+		{
+			if(!differs)
+			{
+				fprintf(stderr, "plancheck: %llu Hz on CLK%d with correction %ld:\n",
+					(unsigned long long)(freq / SI5351_FREQ_MULT), (int)clk, (long)corr);
+			}
+			fprintf(stderr, "  register %u is 0x%02X from set_freq(), 0x%02X from load_plan()\n",
+				reg, run_chip.regs[reg], plan_chip.regs[reg]);
+			differs = 1;
+		}
+	}
+
+	cases++;
+	failed += differs;
+}
+
+template<uint64_t Freq, enum si5351_clock Clk, int32_t Corr>
+static void check_case(void)
+{
+	static constexpr struct Si5351ConstPlan plan = Si5351::plan<XTAL_FREQ, Freq, Clk, Corr>();
+
+	compare(Freq, Clk, Corr, &plan);
+}
+
+template<uint64_t Freq, int32_t Corr>
+static void check_clocks(void)
+{
+	check_case<Freq, SI5351_CLK0, Corr>();
+	check_case<Freq, SI5351_CLK1, Corr>();
+	check_case<Freq, SI5351_CLK2, Corr>();
+	check_case<Freq, SI5351_CLK3, Corr>();
+	check_case<Freq, SI5351_CLK4, Corr>();
+	check_case<Freq, SI5351_CLK5, Corr>();
+	check_case<Freq, SI5351_CLK6, Corr>();
+	check_case<Freq, SI5351_CLK7, Corr>();
+}
+
+template<uint64_t Freq>
+static void check_freq(void)
+{
+	check_clocks<Freq, 0>();
+	check_clocks<Freq, 1200>();
+	check_clocks<Freq, -35000>();
+	check_clocks<Freq, 250000>();
+}
+
+int main(void)
+{
+	check_freq<400000ULL>();         // 4 kHz, the lowest output
+	check_freq<1000000ULL>();        // 10 kHz
+	check_freq<10000000ULL>();       // 100 kHz
+	check_freq<50000000ULL>();       // 500 kHz
+	check_freq<100000000ULL>();      // 1 MHz
+	check_freq<350000000ULL>();      // 3.5 MHz
+	check_freq<707400000ULL>();      // 7.074 MHz
+	check_freq<1000000000ULL>();     // 10 MHz
+	check_freq<1407612333ULL>();     // 14.07612333 MHz
+	check_freq<2500000000ULL>();     // 25 MHz
+	check_freq<5000000000ULL>();     // 50 MHz
+	check_freq<7000000000ULL>();     // 70 MHz
+	check_freq<10000000000ULL>();    // 100 MHz
+	check_freq<11250000000ULL>();    // 112.5 MHz
+	check_freq<12000000000ULL>();    // 120 MHz, which needs a divider of 6 not 7
+	check_freq<14800000000ULL>();    // 148 MHz
+	check_freq<15000000000ULL>();    // 150 MHz
+	check_freq<20000000000ULL>();    // 200 MHz
+
+	fprintf(stderr, "plancheck: %u of %u cases differ\n", failed, cases);
+	fprintf(stderr, "plancheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * sweepcheck.cpp - Check the frequencies of a logarithmic sweep
+ *
+ * This is a host program, not an Arduino sketch. In SI5351_SWEEP_LOG
+ * mode, step k of a sweep from start to stop in n steps should be at
+ * start * (stop / start)^(k / (n - 1)). sweep_step() gets there by
+ * multiplying by a fixed ratio at each step, so any error in the ratio
+ * or in the products builds up over the sweep and shows as a jump at
+ * the last step, which is always set to stop. This program runs log
+ * sweeps up and down on the Si5351Sim chip model and checks every step
+ * against that grid. At each step it also checks that the registers are
+ * the same as set_freq() writes on a second model for that frequency.
+ *
+ * Build and run it with "make -C extras sweep-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+// Allowed distance of a step from the log grid, beyond rounding to the
+// nearest 0.01 Hz, as a fraction of its frequency. A few parts in 10^7
+// is about 1 Hz at 10 MHz.
+#define SWEEP_TOLERANCE 2e-7
+
+struct sweep_case
+{
+	uint64_t start;
+	uint64_t stop;
+	uint16_t steps;
+};
+
+static const struct sweep_case cases[] =
+{
+	{400000ULL, 1000000000ULL, 500},         // 4 kHz to 10 MHz
+	{1000000000ULL, 400000ULL, 500},         // and back down
+	{400000ULL, 10000000000ULL, 1000},       // 4 kHz to 100 MHz, the whole range
+	{10000000000ULL, 400000ULL, 1000},
+	{100000000ULL, 3000000000ULL, 1000},     // 1 MHz to 30 MHz
+	{700000000ULL, 730000000ULL, 3},         // 7 MHz to 7.3 MHz in one middle step
+	{1000000ULL, 4000000ULL, 3}              // Doubling at each step
+};
+
+static int failed = 0;
+
+static void check(const struct sweep_case *c)
+{
+	Si5351Sim chip, ref_chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	Si5351 ref(SI5351_BUS_BASE_ADDR, &ref_chip);
+	struct Si5351Sweep sweep;
+	double ideal, err, worst = 0.0;
+	uint64_t freq;
+	uint16_t k = 0, worst_k = 0;
+	uint8_t more;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	ref.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	ref.set_freq(c->start, SI5351_CLK0);
+
+	if(si5351.start_sweep(&sweep, SI5351_CLK0, c->start, c->stop, c->steps, SI5351_SWEEP_LOG) != 0)
+	{
+		fprintf(stderr, "sweepcheck: %.2f Hz to %.2f Hz in %u steps did not start\n",
+			(double)c->start / SI5351_FREQ_MULT, (double)c->stop / SI5351_FREQ_MULT, c->steps);
+		failed = 1;
+		return;
+	}
+
+	do
+	{
+		freq = si5351.clk_freq[SI5351_CLK0];
+		ideal = (double)c->start * pow((double)c->stop / (double)c->start, (double)k / (c->steps - 1));
+		err = (fabs((double)freq - ideal) - 0.5) / ideal;
+		if(err > worst)
+		{
+			worst = err;
+			worst_k = k;
+		}
+
+		if(k > 0)
+		{
+			ref.set_freq(freq, SI5351_CLK0);
+		}
+		for(uint16_t reg = 1; reg < SI5351_REG_COUNT; reg++)
+		{
+			if(chip.regs[reg] != ref_chip.regs[reg])
+			{
+				fprintf(stderr, "sweepcheck: step %u at %.2f Hz: register %u is 0x%02X, "
+					"set_freq() writes 0x%02X\n", k, (double)freq / SI5351_FREQ_MULT, reg,
+					chip.regs[reg], ref_chip.regs[reg]);
+				failed = 1;
+				return;
+			}
+		}
+
+		more = si5351.sweep_step(&sweep);
+		k++;
+	} while(k < c->steps);
+
+	if(more || freq != c->stop)
+	{
+		fprintf(stderr, "sweepcheck: %.2f Hz to %.2f Hz in %u steps did not end at the stop frequency\n",
+			(double)c->start / SI5351_FREQ_MULT, (double)c->stop / SI5351_FREQ_MULT, c->steps);
+		failed = 1;
+	}
+	if(worst > SWEEP_TOLERANCE)
+	{
+		fprintf(stderr, "sweepcheck: %.2f Hz to %.2f Hz in %u steps: step %u is %.3g off the log grid\n",
+			(double)c->start / SI5351_FREQ_MULT, (double)c->stop / SI5351_FREQ_MULT, c->steps,
+			worst_k, worst);
+		failed = 1;
+	}
+}
+
+int main(void)
+{
+	for(uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		check(&cases[i]);
+	}
+
+	fprintf(stderr, "sweepcheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
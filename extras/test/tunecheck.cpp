@@ -0,0 +1,92 @@
+/*
+ * tunecheck.cpp - Check set_freq() on a PLL in tuning mode
+ *
+ * This is a host program, not an Arduino sketch. In PLL tuning mode
+ * set_freq() retunes the PLL instead of the Multisynth, and has to
+ * report the bus status of that like any other write. This program
+ * steps an output through a few frequencies on the Si5351Sim chip
+ * model, checks that the output follows, and then checks that a retune
+ * over a failing bus does not return 0.
+ *
+ * Build and run it with "make -C extras tune-check".
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "si5351_sim.h"
+
+TwoWire Wire;
+
+// A chip model whose writes can be made to fail with a NACK
+class FailingSim : public Si5351Sim
+{
+public:
+	uint8_t fail = 0;
+
+	uint8_t write(uint8_t i2c_addr, uint8_t reg_addr, const uint8_t *data, uint8_t bytes)
+	{
+		if(fail)
+		{
+			return 3;
+		}
+		return Si5351Sim::write(i2c_addr, reg_addr, data, bytes);
+	}
+};
+
+static const uint64_t tune_freqs[] =
+{
+	1407600000ULL,    // 14.076 MHz
+	1407700000ULL,    // Same divider, PLL only
+	1000000000ULL,    // 10 MHz, a new divider
+	5000000000ULL     // 50 MHz
+};
+
+static int failed = 0;
+
+int main(void)
+{
+	FailingSim chip;
+	Si5351 si5351(SI5351_BUS_BASE_ADDR, &chip);
+	uint8_t result;
+	double real;
+
+	si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0);
+	si5351.set_pll_tuning(SI5351_PLLA, 1);
+
+	for(uint8_t i = 0; i < sizeof(tune_freqs) / sizeof(tune_freqs[0]); i++)
+	{
+		result = si5351.set_freq(tune_freqs[i], SI5351_CLK0);
+		chip.advance(10000);
+		real = chip.get_freq(SI5351_CLK0);
+		if(result != 0 || fabs(real - (double)tune_freqs[i] / SI5351_FREQ_MULT) > 0.01)
+		{
+			fprintf(stderr, "tunecheck: %.2f Hz returned %u and left the output at %.2f Hz\n",
+				(double)tune_freqs[i] / SI5351_FREQ_MULT, result, real);
+			failed = 1;
+		}
+	}
+
+	chip.fail = 1;
+	if(si5351.set_freq(1407800000ULL, SI5351_CLK0) == 0)
+	{
+		fprintf(stderr, "tunecheck: a retune over a failing bus returned 0\n");
+		failed = 1;
+	}
+
+	fprintf(stderr, "tunecheck: %s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
@@ -23,25 +23,92 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "Arduino.h"
 #include "Wire.h"
 #include "si5351.h"
 
+// Define SI5351_NO_HEAP to have the compiler reject any dynamic
+// allocation in the library
+#ifdef SI5351_NO_HEAP
+#pragma GCC poison new delete malloc calloc realloc free
+#endif
+
+// Define SI5351_BUS_STATS to count the I2C traffic of each public
+// method. Without it the accounting compiles away completely.
+#ifdef SI5351_BUS_STATS
+#define SI5351_API_SCOPE(api) ApiScope api_scope(this, api)
+#else
+#define SI5351_API_SCOPE(api)
+#endif
+
+// Define SI5351_MATH_STATS to count the generic 64-bit divisions and the
+// shift-and-subtract steps of udiv_bounded() in the frequency math
+#ifdef SI5351_MATH_STATS
+#define SI5351_COUNT_DIV64(n) math_stats.div64 += (n)
+#define SI5351_COUNT_DIV_STEPS(n) math_stats.div_steps += (n)
+#else
+#define SI5351_COUNT_DIV64(n)
+#define SI5351_COUNT_DIV_STEPS(n)
+#endif
+
 
 /********************/
 /* Public functions */
 /********************/
 
-Si5351::Si5351(uint8_t i2c_addr):
+Si5351::Si5351(uint8_t i2c_addr, Si5351Bus *i2c_bus):
 	i2c_bus_addr(i2c_addr)
 {
+	// Fall back to the global Wire object if no transport was given
+	bus = (i2c_bus != NULL) ? i2c_bus : &wire_bus;
+	bus_speed = 0;
+
 	xtal_freq[0] = SI5351_XTAL_FREQ;
+	xtal_freq[1] = SI5351_XTAL_FREQ;
+	ref_correction[0] = 0;
+	ref_correction[1] = 0;
+
+	// No correction yet, so there is no need for update_ref_freq_corr()
+	ref_freq_corr[0] = SI5351_XTAL_FREQ * SI5351_FREQ_MULT;
+	ref_freq_corr[1] = SI5351_XTAL_FREQ * SI5351_FREQ_MULT;
 
 	// Start by using XO ref osc as default for each PLL
 	plla_ref_osc = SI5351_PLL_INPUT_XO;
 	pllb_ref_osc = SI5351_PLL_INPUT_XO;
 	clkin_div = SI5351_CLKIN_DIV_1;
+
+	txn_depth = 0;
+	async_mode = 0;
+	memset(lock_stats, 0, sizeof(lock_stats));
+	memset(lock_total_us, 0, sizeof(lock_total_us));
+	memset(event_callback, 0, sizeof(event_callback));
+	int_pin = NULL;
+	event_pending = 0;
+	delta_write = 0;
+	verify_write = 0;
+	init_timeout = SI5351_INIT_TIMEOUT;
+	init_time = 0;
+	frac_solver = SI5351_FRAC_FIXED_DENOM;
+	pll_tuning[0] = 0;
+	pll_tuning[1] = 0;
+	memset(pll_tune_div, 0, sizeof(pll_tune_div));
+	memset(pll_tune_rdiv, 0, sizeof(pll_tune_rdiv));
+	pll_tune_clk[0] = SI5351_CLK0;
+	pll_tune_clk[1] = SI5351_CLK0;
+	phased_div = 0;
+	phased_mask = 0;
+	memset(reg_dirty, 0, sizeof(reg_dirty));
+	memset(reg_valid, 0, sizeof(reg_valid));
+
+#ifdef SI5351_BUS_STATS
+	memset(bus_stats, 0, sizeof(bus_stats));
+	stats_api = SI5351_API_RAW;
+#endif
+#ifdef SI5351_MATH_STATS
+	memset(&math_stats, 0, sizeof(math_stats));
+#endif
 }
 
 /*
@@ -57,31 +124,18 @@ Si5351::Si5351(uint8_t i2c_addr):
  * corr - Frequency correction constant in parts-per-billion
  *
  * Returns a boolean that indicates whether a device was found on the desired
- * I2C address.
+ * I2C address and finished its own startup within the timeout set with
+ * set_init_timeout().
  *
  */
 bool Si5351::init(uint8_t xtal_load_c, uint32_t xo_freq, int32_t corr)
 {
-	// Start I2C comms
-	Wire.begin();
+	SI5351_API_SCOPE(SI5351_API_INIT);
 
-	// Check for a device on the bus, bail out if it is not there
-	Wire.beginTransmission(i2c_bus_addr);
-	uint8_t reg_val;
-  reg_val = Wire.endTransmission();
+	uint32_t t0 = micros();
 
-	if(reg_val == 0)
+	if(init_device(xtal_load_c))
 	{
-		// Wait for SYS_INIT flag to be clear, indicating that device is ready
-		uint8_t status_reg = 0;
-		do
-		{
-			status_reg = si5351_read(SI5351_DEVICE_STATUS);
-		} while (status_reg >> 7 == 1);
-
-		// Set crystal load capacitance
-		si5351_write(SI5351_CRYSTAL_LOAD, (xtal_load_c & SI5351_CRYSTAL_LOAD_MASK) | 0b00010010);
-
 		// Set up the XO reference frequency
 		if (xo_freq != 0)
 		{
@@ -97,12 +151,70 @@ bool Si5351::init(uint8_t xtal_load_c, uint32_t xo_freq, int32_t corr)
 
 		reset();
 
+		init_time = micros() - t0;
 		return true;
 	}
 	else
 	{
+		init_time = micros() - t0;
+		return false;
+	}
+}
+
+/*
+ * init_fixed(uint8_t xtal_load_c)
+ *
+ * Setup communications to the Si5351 for use with load_plan() or
+ * load_regs() only. Unlike init(), no frequency math is done here: the
+ * outputs are disabled and set up as reset() leaves them, but the PLLs
+ * are left alone until a plan or table is loaded. A sketch that uses
+ * only init_fixed() and load_plan() does not link any of the run-time
+ * frequency math.
+ *
+ * xtal_load_c - Crystal load capacitance. Use the SI5351_CRYSTAL_LOAD_*PF
+ * defines in the header file
+ *
+ * Returns a boolean that indicates whether a device was found on the desired
+ * I2C address and finished its own startup within the timeout set with
+ * set_init_timeout().
+ */
+bool Si5351::init_fixed(uint8_t xtal_load_c)
+{
+	SI5351_API_SCOPE(SI5351_API_INIT_FIXED);
+
+	uint32_t t0 = micros();
+
+	uint8_t ctrl[8] = {SI5351_CLK_INPUT_MULTISYNTH_N, SI5351_CLK_INPUT_MULTISYNTH_N,
+		SI5351_CLK_INPUT_MULTISYNTH_N, SI5351_CLK_INPUT_MULTISYNTH_N,
+		SI5351_CLK_INPUT_MULTISYNTH_N, SI5351_CLK_INPUT_MULTISYNTH_N,
+		SI5351_CLK_INPUT_MULTISYNTH_N | SI5351_CLK_PLL_SELECT,
+		SI5351_CLK_INPUT_MULTISYNTH_N | SI5351_CLK_PLL_SELECT};
+	uint8_t i;
+
+	if(!init_device(xtal_load_c))
+	{
+		init_time = micros() - t0;
 		return false;
 	}
+
+	// The end state of reset(), without the PLL setup
+	si5351_write(SI5351_OUTPUT_ENABLE_CTRL, 0xFF);
+	si5351_write_bulk(SI5351_CLK0_CTRL, 8, ctrl);
+	for(i = 0; i < 8; i++)
+	{
+		pll_assignment[i] = (i < 6) ? SI5351_PLLA : SI5351_PLLB;
+		clk_freq[i] = 0;
+		clk_first_set[i] = false;
+	}
+	plla_freq = 0;
+	pllb_freq = 0;
+	pll_tune_div[0] = 0;
+	pll_tune_div[1] = 0;
+	phased_div = 0;
+	phased_mask = 0;
+
+	init_time = micros() - t0;
+	return true;
 }
 
 /*
@@ -110,70 +222,67 @@ bool Si5351::init(uint8_t xtal_load_c, uint32_t xo_freq, int32_t corr)
  *
  * Call to reset the Si5351 to the state initialized by the library.
  *
+ * The reset state goes out as a few bursts: the CLK controls (16-23),
+ * both PLLs (26-41), the VCXO parameters (162-164), one reset of both
+ * PLLs, and the output enables (3).
  */
 void Si5351::reset(void)
 {
+	SI5351_API_SCOPE(SI5351_API_RESET);
+
+	struct Si5351RegSet pll_reg;
+	uint8_t pll_params[2 * SI5351_PARAMETERS_LENGTH];
+	uint8_t ctrl[8];
+	uint8_t vcxo[3] = {0, 0, 0};
+	uint8_t i;
+
 	// Initialize the CLK outputs according to flowchart in datasheet
-	// First, turn them off
-	si5351_write(16, 0x80);
-	si5351_write(17, 0x80);
-	si5351_write(18, 0x80);
-	si5351_write(19, 0x80);
-	si5351_write(20, 0x80);
-	si5351_write(21, 0x80);
-	si5351_write(22, 0x80);
-	si5351_write(23, 0x80);
-
-	// Turn the clocks back on...
-	si5351_write(16, 0x0c);
-	si5351_write(17, 0x0c);
-	si5351_write(18, 0x0c);
-	si5351_write(19, 0x0c);
-	si5351_write(20, 0x0c);
-	si5351_write(21, 0x0c);
-	si5351_write(22, 0x0c);
-	si5351_write(23, 0x0c);
-
-	// Set PLLA and PLLB to 800 MHz for automatic tuning
-	set_pll(SI5351_PLL_FIXED, SI5351_PLLA);
-	set_pll(SI5351_PLL_FIXED, SI5351_PLLB);
-
-	// Make PLL to CLK assignments for automatic tuning
-	pll_assignment[0] = SI5351_PLLA;
-	pll_assignment[1] = SI5351_PLLA;
-	pll_assignment[2] = SI5351_PLLA;
-	pll_assignment[3] = SI5351_PLLA;
-	pll_assignment[4] = SI5351_PLLA;
-	pll_assignment[5] = SI5351_PLLA;
-	pll_assignment[6] = SI5351_PLLB;
-	pll_assignment[7] = SI5351_PLLB;
-
-	set_ms_source(SI5351_CLK0, SI5351_PLLA);
-	set_ms_source(SI5351_CLK1, SI5351_PLLA);
-	set_ms_source(SI5351_CLK2, SI5351_PLLA);
-	set_ms_source(SI5351_CLK3, SI5351_PLLA);
-	set_ms_source(SI5351_CLK4, SI5351_PLLA);
-	set_ms_source(SI5351_CLK5, SI5351_PLLA);
-	set_ms_source(SI5351_CLK6, SI5351_PLLB);
-	set_ms_source(SI5351_CLK7, SI5351_PLLB);
+	// First, power them all down in one burst
+	memset(ctrl, SI5351_CLK_POWERDOWN, sizeof(ctrl));
+	si5351_write_bulk(SI5351_CLK0_CTRL, 8, ctrl);
+
+	// Set PLLA and PLLB to 800 MHz for automatic tuning, as one burst
+	// over both parameter blocks (registers 26-41)
+	pll_calc(SI5351_PLLA, SI5351_PLL_FIXED, &pll_reg, ref_correction[plla_ref_osc], 0);
+	pack_params(&pll_reg, pll_params);
+	pll_calc(SI5351_PLLB, SI5351_PLL_FIXED, &pll_reg, ref_correction[pllb_ref_osc], 0);
+	pack_params(&pll_reg, &pll_params[SI5351_PARAMETERS_LENGTH]);
+	si5351_write_bulk(SI5351_PLLA_PARAMETERS, sizeof(pll_params), pll_params);
+	plla_freq = SI5351_PLL_FIXED;
+	pllb_freq = SI5351_PLL_FIXED;
 
 	// Reset the VCXO param
-	si5351_write(SI5351_VXCO_PARAMETERS_LOW, 0);
-	si5351_write(SI5351_VXCO_PARAMETERS_MID, 0);
-	si5351_write(SI5351_VXCO_PARAMETERS_HIGH, 0);
+	si5351_write_bulk(SI5351_VXCO_PARAMETERS_LOW, 3, vcxo);
+
+	// Turn the clocks back on, with the PLL to CLK assignments for
+	// automatic tuning: CLK0-5 on PLLA, CLK6-7 on PLLB
+	for(i = 0; i < 8; i++)
+	{
+		pll_assignment[i] = (i < 6) ? SI5351_PLLA : SI5351_PLLB;
+		ctrl[i] = SI5351_CLK_INPUT_MULTISYNTH_N;
+		if(pll_assignment[i] == SI5351_PLLB)
+		{
+			ctrl[i] |= SI5351_CLK_PLL_SELECT;
+		}
+	}
+	si5351_write_bulk(SI5351_CLK0_CTRL, 8, ctrl);
 
-	// Then reset the PLLs
-	pll_reset(SI5351_PLLA);
-	pll_reset(SI5351_PLLB);
+	// Then reset both PLLs with one write
+	si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_A | SI5351_PLL_RESET_B);
 
-	// Set initial frequencies
-	uint8_t i;
+	// Forget any divider chosen by PLL tuning mode
+	pll_tune_div[0] = 0;
+	pll_tune_div[1] = 0;
+	phased_div = 0;
+	phased_mask = 0;
+
+	// Set initial frequencies, with every output disabled
 	for(i = 0; i < 8; i++)
 	{
 		clk_freq[i] = 0;
-		output_enable((enum si5351_clock)i, 0);
 		clk_first_set[i] = false;
 	}
+	si5351_write(SI5351_OUTPUT_ENABLE_CTRL, 0xFF);
 }
 
 /*
@@ -188,8 +297,11 @@ void Si5351::reset(void)
  */
 uint8_t Si5351::set_freq(uint64_t freq, enum si5351_clock clk)
 {
+	SI5351_API_SCOPE(SI5351_API_SET_FREQ);
+
 	struct Si5351RegSet ms_reg;
 	uint64_t pll_freq;
+	uint64_t ms_ratio;
 	uint8_t int_mode = 0;
 	uint8_t div_by_4 = 0;
 	uint8_t r_div = 0;
@@ -212,6 +324,12 @@ uint8_t Si5351::set_freq(uint64_t freq, enum si5351_clock clk)
 			freq = SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT;
 		}
 
+		// A PLL in tuning mode is driven by a single output
+		if(pll_tuning[pll_assignment[clk]])
+		{
+			return set_freq_pll_tuned(freq, clk);
+		}
+
 		// If requested freq >100 MHz and no other outputs are already >100 MHz,
 		// we need to recalculate PLLA and then recalculate all other CLK outputs
 		// on same PLL
@@ -340,9 +458,12 @@ uint8_t Si5351::set_freq(uint64_t freq, enum si5351_clock clk)
 		{
 			if(clk_freq[7] != 0)
 			{
-				if(pllb_freq % freq == 0)
+				// One division yields both the ratio and the remainder test
+				SI5351_COUNT_DIV64(1);
+				ms_ratio = pllb_freq / freq;
+				if(pllb_freq == ms_ratio * freq)
 				{
-					if((pllb_freq / freq) % 2 != 0)
+					if(ms_ratio % 2 != 0)
 					{
 						// Not an even divide ratio, no bueno
 						return 1;
@@ -383,9 +504,12 @@ uint8_t Si5351::set_freq(uint64_t freq, enum si5351_clock clk)
 		{
 			if(clk_freq[6] != 0)
 			{
-				if(pllb_freq % freq == 0)
+				// One division yields both the ratio and the remainder test
+				SI5351_COUNT_DIV64(1);
+				ms_ratio = pllb_freq / freq;
+				if(pllb_freq == ms_ratio * freq)
 				{
-					if((pllb_freq / freq) % 2 != 0)
+					if(ms_ratio % 2 != 0)
 					{
 						// Not an even divide ratio, no bueno
 						return 1;
@@ -450,6 +574,8 @@ uint8_t Si5351::set_freq(uint64_t freq, enum si5351_clock clk)
  */
 uint8_t Si5351::set_freq_manual(uint64_t freq, uint64_t pll_freq, enum si5351_clock clk)
 {
+	SI5351_API_SCOPE(SI5351_API_SET_FREQ_MANUAL);
+
 	struct Si5351RegSet ms_reg;
 	uint8_t int_mode = 0;
 	uint8_t div_by_4 = 0;
@@ -495,1313 +621,4666 @@ uint8_t Si5351::set_freq_manual(uint64_t freq, uint64_t pll_freq, enum si5351_cl
 }
 
 /*
- * set_pll(uint64_t pll_freq, enum si5351_pll target_pll)
+ * set_freq_fine(uint64_t freq, enum si5351_clock clk, struct Si5351FreqResult *result)
  *
- * Set the specified PLL to a specific oscillation frequency
+ * Sets the clock frequency of the specified CLK output with a resolution
+ * finer than set_freq() allows, using the best rational approximation of
+ * the Multisynth divider that the hardware can hold (denominator up to
+ * 1048575). The output is tuned through its Multisynth against the
+ * frequency its PLL registers really give, with the correction and the
+ * fractional part of the feedback divider, so the same constraints as
+ * set_freq() below 100 MHz apply.
  *
- * pll_freq - Desired PLL frequency in Hz * 100
- * target_pll - Which PLL to set
- *     (use the si5351_pll enum)
+ * freq - Output frequency in Hz * SI5351_FINE_FREQ_MULT (1 uHz units),
+ *   no higher than 100 MHz
+ * clk - Clock output (CLK0 through CLK5 only)
+ *   (use the si5351_clock enum)
+ * result - If not NULL, receives the frequency actually produced and its
+ *   error from the requested frequency, both in 1 uHz units
+ *
+ * Returns 0 on success, or 1 if the frequency or clock is out of range.
  */
-void Si5351::set_pll(uint64_t pll_freq, enum si5351_pll target_pll)
+uint8_t Si5351::set_freq_fine(uint64_t freq, enum si5351_clock clk, struct Si5351FreqResult *result)
 {
-  struct Si5351RegSet pll_reg;
+	SI5351_API_SCOPE(SI5351_API_SET_FREQ_FINE);
 
-	if(target_pll == SI5351_PLLA)
+	struct Si5351RegSet ms_reg;
+	uint64_t pll_freq, ms_freq, rem;
+	uint32_t a, b, c;
+	uint8_t r_div;
+	int64_t err;
+
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5 ||
+		freq > SI5351_MULTISYNTH_SHARE_MAX * SI5351_FINE_FREQ_MULT)
 	{
-		pll_calc(SI5351_PLLA, pll_freq, &pll_reg, ref_correction[plla_ref_osc], 0);
+		return 1;
 	}
-	else
+
+	// Lower bounds check
+	if(freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FINE_FREQ_MULT)
 	{
-		pll_calc(SI5351_PLLB, pll_freq, &pll_reg, ref_correction[pllb_ref_osc], 0);
+		freq = SI5351_CLKOUT_MIN_FREQ * SI5351_FINE_FREQ_MULT;
 	}
 
-  // Derive the register values to write
-
-  // Prepare an array for parameters to be written to
-  uint8_t *params = new uint8_t[20];
-  uint8_t i = 0;
-  uint8_t temp;
+	// Select the proper R div value (the dividers are all powers of 2)
+	ms_freq = freq / (SI5351_FINE_FREQ_MULT / SI5351_FREQ_MULT);
+	r_div = select_r_div(&ms_freq);
+	ms_freq = freq << r_div;
 
-  // Registers 26-27
-  temp = ((pll_reg.p3 >> 8) & 0xFF);
-  params[i++] = temp;
+	// Tune against what the PLL really runs at, not its nominal frequency
+	pll_freq = pll_fine_freq(pll_assignment[clk]);
 
-  temp = (uint8_t)(pll_reg.p3  & 0xFF);
-  params[i++] = temp;
+	// Divider is a + b/c, with b/c the best approximation of the remainder
+	a = pll_freq / ms_freq;
+	rem = pll_freq - (uint64_t)a * ms_freq;
+	best_rational(rem, ms_freq, SI5351_MULTISYNTH_C_MAX, &b, &c);
+	if(b == c)
+	{
+		// Rounded up to the next integer, which leaves a negative remainder
+		a++;
+		b = 0;
+		c = 1;
+		rem -= ms_freq;
+	}
 
-  // Register 28
-  temp = (uint8_t)((pll_reg.p1 >> 16) & 0x03);
-  params[i++] = temp;
+	if(a < SI5351_MULTISYNTH_A_MIN || a > SI5351_MULTISYNTH_A_MAX)
+	{
+		return 1;
+	}
 
-  // Registers 29-30
-  temp = (uint8_t)((pll_reg.p1 >> 8) & 0xFF);
-  params[i++] = temp;
+	// The output error is (c * rem - f * b) / (a * c + b). The numerator is
+	// small even though its terms are not, so wrapping 64-bit math is exact.
+	err = (int64_t)((uint64_t)c * rem - ms_freq * b);
+	err /= (int64_t)((uint64_t)a * c + b);
+	err /= (int64_t)(1 << r_div);
 
-  temp = (uint8_t)(pll_reg.p1  & 0xFF);
-  params[i++] = temp;
+	if(result != NULL)
+	{
+		result->achieved = freq + err;
+		result->error = err;
+	}
 
-  // Register 31
-  temp = (uint8_t)((pll_reg.p3 >> 12) & 0xF0);
-  temp += (uint8_t)((pll_reg.p2 >> 16) & 0x0F);
-  params[i++] = temp;
+	ms_reg.p1 = 128 * a + ((128 * b) / c) - 512;
+	ms_reg.p2 = 128 * b - c * ((128 * b) / c);
+	ms_reg.p3 = c;
 
-  // Registers 32-33
-  temp = (uint8_t)((pll_reg.p2 >> 8) & 0xFF);
-  params[i++] = temp;
+	// Enable the output on first set_freq only
+	if(clk_first_set[(uint8_t)clk] == false)
+	{
+		output_enable(clk, 1);
+		clk_first_set[(uint8_t)clk] = true;
+	}
 
-  temp = (uint8_t)(pll_reg.p2  & 0xFF);
-  params[i++] = temp;
+	clk_freq[(uint8_t)clk] = freq / (SI5351_FINE_FREQ_MULT / SI5351_FREQ_MULT);
 
-  // Write the parameters
-  if(target_pll == SI5351_PLLA)
-  {
-    si5351_write_bulk(SI5351_PLLA_PARAMETERS, i, params);
-		plla_freq = pll_freq;
-  }
-  else if(target_pll == SI5351_PLLB)
-  {
-    si5351_write_bulk(SI5351_PLLB_PARAMETERS, i, params);
-		pllb_freq = pll_freq;
-  }
+	set_ms(clk, ms_reg, 0, r_div, 0);
 
-  delete params;
+	return 0;
 }
 
 /*
- * set_ms(enum si5351_clock clk, struct Si5351RegSet ms_reg, uint8_t int_mode, uint8_t r_div, uint8_t div_by_4)
+ * set_freq_phased(uint64_t freq, const enum si5351_clock *clocks, const uint16_t *phases, uint8_t count)
  *
- * Set the specified multisynth parameters. Not normally needed, but public for advanced users.
+ * Set a group of outputs to the same frequency with fixed phase offsets
+ * between them, for example an I/Q pair with a 90 degree offset.
  *
- * clk - Clock output
+ * The phase offset register counts in quarter periods of the VCO, so an
+ * offset of p degrees on an output with an integer divider d needs a
+ * register value of p * d / 90. This picks an even integer divider (and
+ * the PLL frequency that goes with it) for which every offset is exact
+ * and fits in the 7-bit register, preferring an integer PLL feedback
+ * divider. Offsets of 180 degrees or more are made by inverting the
+ * output and using the remaining offset.
+ *
+ * All of the outputs are moved to the PLL of the first output. Other
+ * outputs already running from that PLL are recalculated. Everything is
+ * written in one transaction, with a single PLL reset at the end.
+ *
+ * freq - Output frequency in Hz * 100
+ * clocks - Array of clock outputs, CLK0 through CLK5 only
  *   (use the si5351_clock enum)
- * int_mode - Set integer mode
- *  Set to 1 to enable, 0 to disable
- * r_div - Desired r_div ratio
- * div_by_4 - Set Divide By 4 mode
- *   Set to 1 to enable, 0 to disable
+ * phases - Phase offset of each output in degrees
+ * count - Number of outputs in the group
+ *
+ * Returns 0 on success, 1 if the frequency is outside the range of
+ * 500 kHz up to (but not including) 150 MHz or no PLL frequency can give
+ * all of the phase offsets, or the last non-zero endTransmission()
+ * status.
  */
-void Si5351::set_ms(enum si5351_clock clk, struct Si5351RegSet ms_reg, uint8_t int_mode, uint8_t r_div, uint8_t div_by_4)
+uint8_t Si5351::set_freq_phased(uint64_t freq, const enum si5351_clock *clocks, const uint16_t *phases, uint8_t count)
 {
-	uint8_t *params = new uint8_t[20];
-	uint8_t i = 0;
- 	uint8_t temp;
- 	uint8_t reg_val;
+	SI5351_API_SCOPE(SI5351_API_SET_FREQ_PHASED);
+
+	struct Si5351RegSet ms_reg;
+	uint64_t pll_freq, temp_freq;
+	uint32_t div, div_max, best_div = 0;
+	uint16_t phase;
+	uint8_t i, ok, r_div, mask = 0;
+	enum si5351_pll target_pll;
 
+	if(count == 0 || freq == 0)
+	{
+		return 1;
+	}
 
-	if((uint8_t)clk <= (uint8_t)SI5351_CLK5)
+	// The Multisynth runs at the output frequency in integer mode without
+	// DIVBY4, and even the largest divider has to bring the PLL up into
+	// its range
+	if(freq * SI5351_MULTISYNTH_A_MAX < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT ||
+		freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT ||
+		freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		if((uint8_t)clocks[i] > (uint8_t)SI5351_CLK5)
+		{
+			return 1;
+		}
+		mask |= (1 << (uint8_t)clocks[i]);
+	}
+	target_pll = pll_assignment[clocks[0]];
+
+	// Range of even integer dividers that keep the PLL in range
+	div = (uint32_t)((SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT + freq - 1) / freq);
+	div_max = ((SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) / freq > SI5351_MULTISYNTH_A_MAX) ?
+		SI5351_MULTISYNTH_A_MAX : (uint32_t)((SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) / freq);
+	if(div < SI5351_MULTISYNTH_A_MIN)
+	{
+		div = SI5351_MULTISYNTH_A_MIN;
+	}
+	div += div & 1;
+
+	for(; div <= div_max; div += 2)
+	{
+		ok = 1;
+		for(i = 0; i < count && ok; i++)
+		{
+			phase = phases[i] % 360;
+			if(phase >= 180)
+			{
+				phase -= 180;
+			}
+			if(((uint32_t)phase * div) % 90 != 0 || ((uint32_t)phase * div) / 90 > 0x7F)
+			{
+				ok = 0;
+			}
+		}
+		if(!ok)
+		{
+			continue;
+		}
+
+		if(best_div == 0)
+		{
+			best_div = div;
+		}
+		if((freq * div) % ref_freq_corr[(uint8_t)(target_pll == SI5351_PLLA ? plla_ref_osc : pllb_ref_osc)] == 0)
+		{
+			best_div = div;
+			break;
+		}
+	}
+
+	if(best_div == 0)
 	{
-		// Registers 42-43 for CLK0
-		temp = (uint8_t)((ms_reg.p3 >> 8) & 0xFF);
-		params[i++] = temp;
+		return 1;
+	}
 
-		temp = (uint8_t)(ms_reg.p3  & 0xFF);
-		params[i++] = temp;
+	pll_freq = freq * best_div;
 
-		// Register 44 for CLK0
-		reg_val = si5351_read((SI5351_CLK0_PARAMETERS + 2) + (clk * 8));
-		reg_val &= ~(0x03);
-		temp = reg_val | ((uint8_t)((ms_reg.p1 >> 16) & 0x03));
-		params[i++] = temp;
+	begin_transaction();
 
-		// Registers 45-46 for CLK0
-		temp = (uint8_t)((ms_reg.p1 >> 8) & 0xFF);
-		params[i++] = temp;
+	set_pll(pll_freq, target_pll);
 
-		temp = (uint8_t)(ms_reg.p1  & 0xFF);
-		params[i++] = temp;
+	for(i = 0; i < count; i++)
+	{
+		if(pll_assignment[clocks[i]] != target_pll)
+		{
+			set_ms_source(clocks[i], target_pll);
+		}
 
-		// Register 47 for CLK0
-		temp = (uint8_t)((ms_reg.p3 >> 12) & 0xF0);
-		temp += (uint8_t)((ms_reg.p2 >> 16) & 0x0F);
-		params[i++] = temp;
+		multisynth_calc(freq, pll_freq, &ms_reg);
+		set_ms(clocks[i], ms_reg, 1, SI5351_OUTPUT_CLK_DIV_1, 0);
 
-		// Registers 48-49 for CLK0
-		temp = (uint8_t)((ms_reg.p2 >> 8) & 0xFF);
-		params[i++] = temp;
+		phase = phases[i] % 360;
+		set_clock_invert(clocks[i], (phase >= 180) ? 1 : 0);
+		if(phase >= 180)
+		{
+			phase -= 180;
+		}
+		set_phase(clocks[i], ((uint32_t)phase * best_div) / 90);
 
-		temp = (uint8_t)(ms_reg.p2  & 0xFF);
-		params[i++] = temp;
+		if(clk_first_set[(uint8_t)clocks[i]] == false)
+		{
+			output_enable(clocks[i], 1);
+			clk_first_set[(uint8_t)clocks[i]] = true;
+		}
+		clk_freq[(uint8_t)clocks[i]] = freq;
 	}
-	else
+
+	// Recalculate params for other synths on same PLL
+	for(i = 0; i < 6; i++)
 	{
-		// MS6 and MS7 only use one register
-		temp = ms_reg.p1;
+		if(clk_freq[i] != 0 && !(mask & (1 << i)) && pll_assignment[i] == target_pll)
+		{
+			temp_freq = clk_freq[i];
+			r_div = select_r_div(&temp_freq);
+			multisynth_calc(temp_freq, pll_freq, &ms_reg);
+			set_ms((enum si5351_clock)i, ms_reg, 0, r_div, 0);
+		}
 	}
 
-	// Write the parameters
-	switch(clk)
+	pll_reset(target_pll);
+
+	phased_pll = target_pll;
+	phased_div = best_div;
+	phased_mask = mask;
+
+	return commit();
+}
+
+/*
+ * retune_phased(uint64_t freq)
+ *
+ * Move the group of outputs set by the last set_freq_phased() call to a
+ * new frequency, keeping their phase offsets. Only the PLL parameters
+ * are written; the Multisynth dividers and phase registers stay as they
+ * are, and there is no PLL reset, so the outputs keep their alignment.
+ * Any other output running from the same PLL moves by the same ratio,
+ * and its clk_freq entry is scaled to match.
+ *
+ * freq - Output frequency in Hz * 100
+ *
+ * Returns 0 on success, or 1 if there is no phased group or the new
+ * frequency would take the PLL out of range with the current divider.
+ * In that case call set_freq_phased() again.
+ */
+uint8_t Si5351::retune_phased(uint64_t freq)
+{
+	SI5351_API_SCOPE(SI5351_API_RETUNE_PHASED);
+
+	uint64_t pll_freq, old_pll_freq;
+	uint8_t i;
+
+	if(phased_div == 0)
 	{
-		case SI5351_CLK0:
-			si5351_write_bulk(SI5351_CLK0_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK1:
-			si5351_write_bulk(SI5351_CLK1_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK2:
-			si5351_write_bulk(SI5351_CLK2_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK3:
-			si5351_write_bulk(SI5351_CLK3_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK4:
-			si5351_write_bulk(SI5351_CLK4_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK5:
-			si5351_write_bulk(SI5351_CLK5_PARAMETERS, i, params);
-			set_int(clk, int_mode);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK6:
-			si5351_write(SI5351_CLK6_PARAMETERS, temp);
-			ms_div(clk, r_div, div_by_4);
-			break;
-		case SI5351_CLK7:
-			si5351_write(SI5351_CLK7_PARAMETERS, temp);
-			ms_div(clk, r_div, div_by_4);
-			break;
+		return 1;
+	}
+
+	pll_freq = freq * phased_div;
+	if(pll_freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT || pll_freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+	{
+		return 1;
+	}
+
+	old_pll_freq = (phased_pll == SI5351_PLLA) ? plla_freq : pllb_freq;
+	set_pll(pll_freq, phased_pll);
+
+	for(i = 0; i < 8; i++)
+	{
+		if(phased_mask & (1 << i))
+		{
+			clk_freq[i] = freq;
+		}
+		else if(clk_freq[i] != 0 && pll_assignment[i] == phased_pll && clk_freq[i] < old_pll_freq)
+		{
+			// Same Multisynth divider, so the same ratio as the PLL
+			clk_freq[i] = mul_div(clk_freq[i], pll_freq, old_pll_freq);
+		}
 	}
 
-	delete params;
+	return 0;
 }
 
 /*
- * output_enable(enum si5351_clock clk, uint8_t enable)
+ * compile_freq_list(enum si5351_clock clk, const uint64_t *freqs, uint16_t count, struct Si5351FreqStep *steps)
  *
- * Enable or disable a chosen output
- * clk - Clock output
+ * Precompute the Multisynth register images for a list of output
+ * frequencies, for later use with play_freq_list(). Each step also
+ * records which span of the parameter block differs from the previous
+ * step, so that playback only sends the changed bytes.
+ *
+ * The list is computed against the present frequency of the PLL that
+ * the clock is assigned to, so the PLL must not be changed between
+ * compiling and playing the list.
+ *
+ * clk - Clock output (CLK0 through CLK5 only)
  *   (use the si5351_clock enum)
- * enable - Set to 1 to enable, 0 to disable
+ * freqs - Array of output frequencies in Hz * 100, each no higher than
+ *   100 MHz
+ * count - Number of entries in freqs and steps
+ * steps - Array to hold the compiled steps
+ *
+ * Returns the number of steps compiled, which is less than count if an
+ * entry in freqs is out of range.
  */
-void Si5351::output_enable(enum si5351_clock clk, uint8_t enable)
+uint16_t Si5351::compile_freq_list(enum si5351_clock clk, const uint64_t *freqs, uint16_t count, struct Si5351FreqStep *steps)
 {
-  uint8_t reg_val;
+	uint16_t n, prev, compiled;
+	uint8_t i;
 
-  reg_val = si5351_read(SI5351_OUTPUT_ENABLE_CTRL);
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5)
+	{
+		return 0;
+	}
 
-  if(enable == 1)
-  {
-    reg_val &= ~(1<<(uint8_t)clk);
-  }
-  else
-  {
-    reg_val |= (1<<(uint8_t)clk);
-  }
+	for(n = 0; n < count; n++)
+	{
+		if(calc_freq_step(clk, freqs[n], &steps[n]))
+		{
+			break;
+		}
+	}
 
-  si5351_write(SI5351_OUTPUT_ENABLE_CTRL, reg_val);
+	// Find the span that changes from the previous step (the first step is
+	// compared with the last one so that the list can be replayed in a loop)
+	compiled = n;
+	for(n = 0; n < compiled; n++)
+	{
+		prev = (n == 0) ? compiled - 1 : n - 1;
+		steps[n].first = SI5351_PARAMETERS_LENGTH;
+		steps[n].len = 0;
+		for(i = 0; i < SI5351_PARAMETERS_LENGTH; i++)
+		{
+			if(steps[n].params[i] != steps[prev].params[i])
+			{
+				if(steps[n].first == SI5351_PARAMETERS_LENGTH)
+				{
+					steps[n].first = i;
+				}
+				steps[n].len = i - steps[n].first + 1;
+			}
+		}
+	}
+
+	return compiled;
 }
 
 /*
- * drive_strength(enum si5351_clock clk, enum si5351_drive drive)
+ * play_freq_list(enum si5351_clock clk, const struct Si5351FreqStep *steps, uint16_t count, void (*dwell)(uint16_t))
  *
- * Sets the drive strength of the specified clock output
+ * Step the given clock output through a list compiled with
+ * compile_freq_list(). No frequency math is done here; the first step is
+ * written in full and each following step sends a single burst holding
+ * only the bytes that differ from the step before it.
  *
- * clk - Clock output
+ * The clk_freq member is not updated by this method.
+ *
+ * clk - Clock output the list was compiled for
  *   (use the si5351_clock enum)
- * drive - Desired drive level
- *   (use the si5351_drive enum)
+ * steps - Compiled step list
+ * count - Number of steps to play
+ * dwell - Function called after each step is written, with the step
+ *   index as its argument, or NULL to step as fast as possible
  */
-void Si5351::drive_strength(enum si5351_clock clk, enum si5351_drive drive)
+void Si5351::play_freq_list(enum si5351_clock clk, const struct Si5351FreqStep *steps, uint16_t count, void (*dwell)(uint16_t))
 {
-  uint8_t reg_val;
-  const uint8_t mask = 0x03;
+	SI5351_API_SCOPE(SI5351_API_PLAY_FREQ_LIST);
 
-  reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
-  reg_val &= ~(mask);
+	uint8_t base;
+	uint16_t n;
 
-  switch(drive)
-  {
-  case SI5351_DRIVE_2MA:
-    reg_val |= 0x00;
-    break;
-  case SI5351_DRIVE_4MA:
-   reg_val |= 0x01;
-    break;
-  case SI5351_DRIVE_6MA:
-    reg_val |= 0x02;
-    break;
-  case SI5351_DRIVE_8MA:
-    reg_val |= 0x03;
-    break;
-  default:
-    break;
-  }
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5 || count == 0)
+	{
+		return;
+	}
 
-  si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
-}
+	base = SI5351_CLK0_PARAMETERS + (clk * 8);
 
-/*
- * update_status(void)
- *
- * Call this to update the status structs, then access them
- * via the dev_status and dev_int_status global members.
- *
- * See the header file for the struct definitions. These
- * correspond to the flag names for registers 0 and 1 in
- * the Si5351 datasheet.
- */
-void Si5351::update_status(void)
-{
-	update_sys_status(&dev_status);
-	update_int_status(&dev_int_status);
-}
+	// Enable the output on first use, as set_freq() does
+	if(clk_first_set[(uint8_t)clk] == false)
+	{
+		output_enable(clk, 1);
+		clk_first_set[(uint8_t)clk] = true;
+	}
+	set_int(clk, 0);
 
-/*
- * set_correction(int32_t corr, enum si5351_pll_input ref_osc)
- *
- * corr - Correction factor in ppb
- * ref_osc - Desired reference oscillator
- *     (use the si5351_pll_input enum)
- *
- * Use this to set the oscillator correction factor.
- * This value is a signed 32-bit integer of the
- * parts-per-billion value that the actual oscillation
- * frequency deviates from the specified frequency.
- *
- * The frequency calibration is done as a one-time procedure.
- * Any desired test frequency within the normal range of the
- * Si5351 should be set, then the actual output frequency
- * should be measured as accurately as possible. The
- * difference between the measured and specified frequencies
- * should be calculated in Hertz, then multiplied by 10 in
- * order to get the parts-per-billion value.
- *
- * Since the Si5351 itself has an intrinsic 0 PPM error, this
- * correction factor is good across the entire tuning range of
- * the Si5351. Once this calibration is done accurately, it
- * should not have to be done again for the same Si5351 and
- * crystal.
- */
-void Si5351::set_correction(int32_t corr, enum si5351_pll_input ref_osc)
-{
-	ref_correction[(uint8_t)ref_osc] = corr;
+	for(n = 0; n < count; n++)
+	{
+		if(n == 0)
+		{
+			si5351_write_bulk(base, SI5351_PARAMETERS_LENGTH, (uint8_t *)steps[n].params);
+		}
+		else if(steps[n].len != 0)
+		{
+			si5351_write_bulk(base + steps[n].first, steps[n].len,
+				(uint8_t *)&steps[n].params[steps[n].first]);
+		}
 
-	// Recalculate and set PLL freqs based on correction value
-	set_pll(plla_freq, SI5351_PLLA);
-	set_pll(pllb_freq, SI5351_PLLB);
+		if(dwell != NULL)
+		{
+			dwell(n);
+		}
+	}
 }
 
 /*
- * set_phase(enum si5351_clock clk, uint8_t phase)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * phase - 7-bit phase word
- *   (in units of VCO/4 period)
- *
- * Write the 7-bit phase register. This must be used
- * with a user-set PLL frequency so that the user can
- * calculate the proper tuning word based on the PLL period.
+ * Helpers for plan_outputs(). A candidate is a set of outputs that can
+ * all be driven by integer Multisynth dividers from one PLL frequency.
  */
-void Si5351::set_phase(enum si5351_clock clk, uint8_t phase)
+struct si5351_plan_cand
 {
-	// Mask off the upper bit since it is reserved
-	phase = phase & 0b01111111;
-
-	si5351_write(SI5351_CLK0_PHASE_OFFSET + (uint8_t)clk, phase);
-}
+	uint8_t mask;
+	uint8_t evens;
+	uint64_t vco;
+};
 
-/*
- * get_correction(enum si5351_pll_input ref_osc)
- *
- * ref_osc - Desired reference oscillator
- *     0: crystal oscillator (XO)
- *     1: external clock input (CLKIN)
- *
- * Returns the oscillator correction factor stored
- * in RAM.
- */
-int32_t Si5351::get_correction(enum si5351_pll_input ref_osc)
+struct si5351_plan_ctx
 {
-	return ref_correction[(uint8_t)ref_osc];
-}
+	uint64_t ms_freq[8];
+	uint8_t ms_mask;
+	uint64_t ref_freq;
+	struct si5351_plan_cand cand[SI5351_PLAN_CANDIDATES];
+	uint8_t cand_count;
+};
 
-/*
- * pll_reset(enum si5351_pll target_pll)
- *
- * target_pll - Which PLL to reset
- *     (use the si5351_pll enum)
- *
- * Apply a reset to the indicated PLL.
- */
-void Si5351::pll_reset(enum si5351_pll target_pll)
+static uint8_t plan_popcount(uint8_t mask)
 {
-	if(target_pll == SI5351_PLLA)
- 	{
-    	si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_A);
-	}
-	else if(target_pll == SI5351_PLLB)
+	uint8_t n = 0;
+
+	while(mask)
 	{
-	    si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_B);
+		mask &= mask - 1;
+		n++;
 	}
+	return n;
 }
 
-/*
- * set_ms_source(enum si5351_clock clk, enum si5351_pll pll)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * pll - Which PLL to use as the source
- *     (use the si5351_pll enum)
- *
- * Set the desired PLL source for a multisynth.
- */
-void Si5351::set_ms_source(enum si5351_clock clk, enum si5351_pll pll)
+static uint64_t plan_gcd(uint64_t a, uint64_t b)
 {
-	uint8_t reg_val;
+	uint64_t t;
 
-	reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
+	while(b != 0)
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
 
-	if(pll == SI5351_PLLA)
+// Whether an integer divider is usable for a Multisynth frequency
+static uint8_t plan_div_ok(uint8_t clk, uint64_t ms_freq, uint64_t div)
+{
+	if(clk > SI5351_CLK5)
 	{
-		reg_val &= ~(SI5351_CLK_PLL_SELECT);
+		return (div % 2 == 0 && div >= SI5351_MULTISYNTH_A_MIN && div <= SI5351_MULTISYNTH67_A_MAX) ? 1 : 0;
 	}
-	else if(pll == SI5351_PLLB)
+	if(ms_freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
 	{
-		reg_val |= SI5351_CLK_PLL_SELECT;
+		return (div == 4) ? 1 : 0;
 	}
-
-	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
-
-	pll_assignment[(uint8_t)clk] = pll;
+	return (div == 6 || (div >= 8 && div <= SI5351_MULTISYNTH_A_MAX)) ? 1 : 0;
 }
 
-/*
- * set_int(enum si5351_clock clk, uint8_t int_mode)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * enable - Set to 1 to enable, 0 to disable
- *
- * Set the indicated multisynth into integer mode.
- */
-void Si5351::set_int(enum si5351_clock clk, uint8_t enable)
+// Whether a fractional divider can reach a Multisynth frequency
+static uint8_t plan_frac_ok(uint8_t clk, uint64_t ms_freq, uint64_t vco)
 {
-	uint8_t reg_val;
-	reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
-
-	if(enable == 1)
+	if(clk > SI5351_CLK5 || ms_freq > SI5351_MULTISYNTH_SHARE_MAX * SI5351_FREQ_MULT)
 	{
-		reg_val |= (SI5351_CLK_INTEGER_MODE);
+		return 0;
 	}
-	else
+	return (vco >= ms_freq * 8 && vco <= ms_freq * SI5351_MULTISYNTH_A_MAX) ? 1 : 0;
+}
+
+// Pick the best PLL frequency that is a multiple of lcm for a set of
+// outputs, preferring integer feedback and then even dividers
+static uint8_t plan_vco(struct si5351_plan_ctx *ctx, uint8_t mask, uint64_t lcm, uint64_t *vco, uint8_t *evens)
+{
+	uint64_t k, k_min, k_max, step, v, div;
+	uint8_t i, ok, n, q;
+	int16_t best = -1;
+
+	k_min = (SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT + lcm - 1) / lcm;
+	k_max = (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) / lcm;
+	if(k_min > k_max)
 	{
-		reg_val &= ~(SI5351_CLK_INTEGER_MODE);
+		return 0;
 	}
 
-	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+	// Sample wide ranges, which only happen for sets of low frequencies
+	step = (k_max - k_min) / 64 + 1;
 
-	// Integer mode indication
-	/*
-	switch(clk)
+	for(k = k_min; k <= k_max; k += step)
 	{
-	case SI5351_CLK0:
-		clk0_int_mode = enable;
-		break;
-	case SI5351_CLK1:
-		clk1_int_mode = enable;
-		break;
-	case SI5351_CLK2:
-		clk2_int_mode = enable;
-		break;
-	default:
-		break;
+		v = k * lcm;
+		ok = 1;
+		n = 0;
+		for(i = 0; i < 8 && ok; i++)
+		{
+			if(mask & (1 << i))
+			{
+				div = v / ctx->ms_freq[i];
+				ok = plan_div_ok(i, ctx->ms_freq[i], div);
+				n += (div % 2 == 0) ? 1 : 0;
+			}
+		}
+		if(!ok)
+		{
+			continue;
+		}
+
+		q = n + ((v % ctx->ref_freq == 0) ? 16 : 0);
+		if((int16_t)q > best)
+		{
+			best = q;
+			*vco = v;
+			*evens = n;
+		}
 	}
-	*/
+
+	return (best >= 0) ? 1 : 0;
 }
 
-/*
- * set_clock_pwr(enum si5351_clock clk, uint8_t pwr)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * pwr - Set to 1 to enable, 0 to disable
- *
- * Enable or disable power to a clock output (a power
- * saving feature).
- */
-void Si5351::set_clock_pwr(enum si5351_clock clk, uint8_t pwr)
+// Depth-first walk over all sets of outputs whose lcm still fits in
+// the VCO range, keeping the largest feasible sets
+static void plan_search(struct si5351_plan_ctx *ctx, uint8_t start, uint8_t mask, uint64_t lcm)
 {
-	uint8_t reg_val; //, reg;
-	reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
+	struct si5351_plan_cand c;
+	uint64_t l, g;
+	uint8_t i, j, worst;
 
-	if(pwr == 1)
-	{
-		reg_val &= 0b01111111;
-	}
-	else
+	for(i = start; i < 8; i++)
 	{
-		reg_val |= 0b10000000;
-	}
+		if(!(ctx->ms_mask & (1 << i)))
+		{
+			continue;
+		}
 
-	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+		if(mask == 0)
+		{
+			l = ctx->ms_freq[i];
+		}
+		else
+		{
+			g = plan_gcd(lcm, ctx->ms_freq[i]);
+			if(lcm / g > (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) / ctx->ms_freq[i])
+			{
+				continue;
+			}
+			l = lcm / g * ctx->ms_freq[i];
+		}
+
+		c.mask = mask | (1 << i);
+		if(!plan_vco(ctx, c.mask, l, &c.vco, &c.evens))
+		{
+			// No superset can work either
+			continue;
+		}
+
+		if(ctx->cand_count < SI5351_PLAN_CANDIDATES)
+		{
+			ctx->cand[ctx->cand_count++] = c;
+		}
+		else
+		{
+			// Make room by dropping the smallest set
+			worst = 0;
+			for(j = 1; j < SI5351_PLAN_CANDIDATES; j++)
+			{
+				if(plan_popcount(ctx->cand[j].mask) < plan_popcount(ctx->cand[worst].mask))
+				{
+					worst = j;
+				}
+			}
+			if(plan_popcount(ctx->cand[worst].mask) < plan_popcount(c.mask))
+			{
+				ctx->cand[worst] = c;
+			}
+		}
+
+		plan_search(ctx, i + 1, c.mask, l);
+	}
 }
 
 /*
- * set_clock_invert(enum si5351_clock clk, uint8_t inv)
+ * plan_outputs(const uint64_t *freqs, const uint64_t *tolerance, struct Si5351Plan *plan)
  *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * inv - Set to 1 to enable, 0 to disable
+ * Work out a configuration of the whole chip for a set of output
+ * frequencies, for use with apply_plan(). Unlike calling set_freq() for
+ * each output, the result does not depend on the order of the outputs.
  *
- * Enable to invert the clock output waveform.
+ * Outputs matching the crystal (or CLKIN, if a PLL uses it) are driven
+ * straight from the reference. The rest are split between PLLA and PLLB
+ * so that as many as possible get integer Multisynth dividers, which is
+ * required above 100 MHz and on CLK6/7, preferring integer PLL feedback
+ * and even dividers for the lowest jitter. Any remaining outputs up to
+ * 100 MHz get fractional dividers.
+ *
+ * freqs - Array of 8 output frequencies in Hz * 100, one for each of
+ *   CLK0 through CLK7, with 0 for an output that is not used
+ * tolerance - Array of 8 allowed frequency errors in Hz * 100, or NULL
+ *   to allow 1 Hz on every output
+ * plan - Pointer to the struct that receives the plan
+ *
+ * Returns a bit mask of the outputs that could not be placed within
+ * their tolerance (bit 0 for CLK0), or 0 if all of them can.
  */
-void Si5351::set_clock_invert(enum si5351_clock clk, uint8_t inv)
+uint8_t Si5351::plan_outputs(const uint64_t *freqs, const uint64_t *tolerance, struct Si5351Plan *plan)
 {
-	uint8_t reg_val;
-	reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
+	struct si5351_plan_ctx ctx;
+	struct Si5351RegSet reg;
+	uint64_t freq, tol, ref, v, div, err;
+	uint64_t vco[2];
+	uint8_t mask[2];
+	uint8_t use_clkin;
+	uint8_t i, left;
+	int8_t a, b;
+	int16_t score, best_score = -1;
+	int8_t best_a = -1, best_b = -1;
+
+	memset(plan, 0, sizeof(struct Si5351Plan));
+	memset(&ctx, 0, sizeof(ctx));
+
+	use_clkin = (plla_ref_osc == SI5351_PLL_INPUT_CLKIN || pllb_ref_osc == SI5351_PLL_INPUT_CLKIN) &&
+		clkin_div == SI5351_CLKIN_DIV_1;
 
-	if(inv == 1)
-	{
-		reg_val |= (SI5351_CLK_INVERT);
-	}
-	else
+	for(i = 0; i < 8; i++)
 	{
-		reg_val &= ~(SI5351_CLK_INVERT);
-	}
+		freq = freqs[i];
+		tol = (tolerance != NULL) ? tolerance[i] : SI5351_FREQ_MULT;
+		plan->pll[i] = SI5351_PLLA;
+		plan->source[i] = SI5351_CLK_SRC_MS;
 
-	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
-}
-
-/*
- * set_clock_source(enum si5351_clock clk, enum si5351_clock_source src)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * src - Which clock source to use for the multisynth
- *   (use the si5351_clock_source enum)
- *
- * Set the clock source for a multisynth (based on the options
- * presented for Registers 16-23 in the Silicon Labs AN619 document).
- * Choices are XTAL, CLKIN, MS0, or the multisynth associated with
- * the clock output.
- */
-void Si5351::set_clock_source(enum si5351_clock clk, enum si5351_clock_source src)
-{
-	uint8_t reg_val;
-	reg_val = si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk);
+		if(freq == 0)
+		{
+			continue;
+		}
 
-	// Clear the bits first
-	reg_val &= ~(SI5351_CLK_INPUT_MASK);
+		// Output bounds, as in set_freq()
+		if(freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT)
+		{
+			freq = SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT;
+		}
+		plan->freq[i] = freq;
+		if(freq > ((i > SI5351_CLK5) ? SI5351_CLKOUT67_MAX_FREQ : SI5351_CLKOUT_MAX_FREQ) * SI5351_FREQ_MULT)
+		{
+			plan->failed |= (1 << i);
+			continue;
+		}
 
-	switch(src)
-	{
-	case SI5351_CLK_SRC_XTAL:
-		reg_val |= (SI5351_CLK_INPUT_XTAL);
-		break;
-	case SI5351_CLK_SRC_CLKIN:
-		reg_val |= (SI5351_CLK_INPUT_CLKIN);
-		break;
-	case SI5351_CLK_SRC_MS0:
-		if(clk == SI5351_CLK0)
+		// Straight from the reference oscillator
+		ref = ref_freq_corr[SI5351_PLL_INPUT_XO];
+		if((freq > ref ? freq - ref : ref - freq) <= tol)
 		{
-			return;
+			plan->source[i] = SI5351_CLK_SRC_XTAL;
+			plan->achieved[i] = ref;
+			continue;
+		}
+		ref = ref_freq_corr[SI5351_PLL_INPUT_CLKIN];
+		if(use_clkin && (freq > ref ? freq - ref : ref - freq) <= tol)
+		{
+			plan->source[i] = SI5351_CLK_SRC_CLKIN;
+			plan->achieved[i] = ref;
+			continue;
 		}
 
-		reg_val |= (SI5351_CLK_INPUT_MULTISYNTH_0_4);
-		break;
-	case SI5351_CLK_SRC_MS:
-		reg_val |= (SI5351_CLK_INPUT_MULTISYNTH_N);
-		break;
-	default:
-		return;
+		ctx.ms_freq[i] = freq;
+		plan->r_div[i] = (i > SI5351_CLK5) ? select_r_div_ms67(&ctx.ms_freq[i]) : select_r_div(&ctx.ms_freq[i]);
+		ctx.ms_mask |= (1 << i);
 	}
 
-	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
-}
-
-/*
- * set_clock_disable(enum si5351_clock clk, enum si5351_clock_disable dis_state)
- *
- * clk - Clock output
- *   (use the si5351_clock enum)
- * dis_state - Desired state of the output upon disable
- *   (use the si5351_clock_disable enum)
- *
- * Set the state of the clock output when it is disabled. Per page 27
- * of AN619 (Registers 24 and 25), there are four possible values: low,
- * high, high impedance, and never disabled.
- */
-void Si5351::set_clock_disable(enum si5351_clock clk, enum si5351_clock_disable dis_state)
-{
-	uint8_t reg_val, reg;
+	// Find the sets of outputs that can share a PLL with integer dividers
+	ctx.ref_freq = ref_freq_corr[(uint8_t)plla_ref_osc];
+	plan_search(&ctx, 0, 0, 0);
 
-	if (clk >= SI5351_CLK0 && clk <= SI5351_CLK3)
+	// Default PLL frequency for a PLL with only fractional outputs: the
+	// multiple of the reference nearest to SI5351_PLL_FIXED
+	for(i = 0; i < 2; i++)
 	{
-		reg = SI5351_CLK3_0_DISABLE_STATE;
+		ref = ref_freq_corr[(uint8_t)(i == 0 ? plla_ref_osc : pllb_ref_osc)];
+		v = ((SI5351_PLL_FIXED + ref / 2) / ref) * ref;
+		while(v > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+		{
+			v -= ref;
+		}
+		while(v < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT)
+		{
+			v += ref;
+		}
+		vco[i] = v;
 	}
-	else if(clk >= SI5351_CLK4 && clk <= SI5351_CLK7)
+
+	// Try every pair of sets for PLLA and PLLB (-1 is the empty set)
+	for(a = -1; a < (int8_t)ctx.cand_count; a++)
 	{
-		reg = SI5351_CLK7_4_DISABLE_STATE;
-	}
-	else return;
+		for(b = -1; b < (int8_t)ctx.cand_count; b++)
+		{
+			mask[0] = (a < 0) ? 0 : ctx.cand[a].mask;
+			mask[1] = (b < 0) ? 0 : ctx.cand[b].mask;
+			if(mask[0] & mask[1])
+			{
+				continue;
+			}
+
+			// Every output left over needs a fractional divider
+			left = ctx.ms_mask & ~(mask[0] | mask[1]);
+			for(i = 0; i < 8; i++)
+			{
+				if((left & (1 << i)) &&
+					!plan_frac_ok(i, ctx.ms_freq[i], (a < 0) ? vco[0] : ctx.cand[a].vco) &&
+					!plan_frac_ok(i, ctx.ms_freq[i], (b < 0) ? vco[1] : ctx.cand[b].vco))
+				{
+					left &= ~(1 << i);
+				}
+			}
 
-	reg_val = si5351_read(reg);
+			// Place as many outputs as possible, then as many integer
+			// dividers as possible, then prefer integer feedback and
+			// even dividers, and finally leaving PLLB free
+			score = 128 * plan_popcount(mask[0] | mask[1] | left) + 64 * plan_popcount(mask[0] | mask[1]);
+			if(a >= 0)
+			{
+				score += 2 * ctx.cand[a].evens + ((ctx.cand[a].vco % ref_freq_corr[(uint8_t)plla_ref_osc] == 0) ? 32 : 0);
+			}
+			if(b >= 0)
+			{
+				score += 2 * ctx.cand[b].evens + ((ctx.cand[b].vco % ref_freq_corr[(uint8_t)pllb_ref_osc] == 0) ? 32 : 0);
+			}
+			else
+			{
+				score += 1;
+			}
+			if(score > best_score || (score == best_score && best_a < 0 && a >= 0))
+			{
+				best_score = score;
+				best_a = a;
+				best_b = b;
+			}
+		}
+	}
 
-	if (clk >= SI5351_CLK0 && clk <= SI5351_CLK3)
+	mask[0] = (best_a < 0) ? 0 : ctx.cand[best_a].mask;
+	mask[1] = (best_b < 0) ? 0 : ctx.cand[best_b].mask;
+	if(best_a >= 0)
 	{
-		reg_val &= ~(0b11 << (clk * 2));
-		reg_val |= dis_state << (clk * 2);
+		vco[0] = ctx.cand[best_a].vco;
 	}
-	else if(clk >= SI5351_CLK4 && clk <= SI5351_CLK7)
+	if(best_b >= 0)
 	{
-		reg_val &= ~(0b11 << ((clk - 4) * 2));
-		reg_val |= dis_state << ((clk - 4) * 2);
+		vco[1] = ctx.cand[best_b].vco;
 	}
 
-	si5351_write(reg, reg_val);
-}
-
-/*
- * set_clock_fanout(enum si5351_clock_fanout fanout, uint8_t enable)
- *
- * fanout - Desired clock fanout
- *   (use the si5351_clock_fanout enum)
- * enable - Set to 1 to enable, 0 to disable
- *
- * Use this function to enable or disable the clock fanout options
- * for individual clock outputs. If you intend to output the XO or
- * CLKIN on the clock outputs, enable this first.
- *
- * By default, only the Multisynth fanout is enabled at startup.
- */
-void Si5351::set_clock_fanout(enum si5351_clock_fanout fanout, uint8_t enable)
-{
-	uint8_t reg_val;
-	reg_val = si5351_read(SI5351_FANOUT_ENABLE);
-
-	switch(fanout)
+	// Assign the outputs and check the frequencies that will be reached
+	for(i = 0; i < 8; i++)
 	{
-	case SI5351_FANOUT_CLKIN:
-		if(enable)
+		if(!(ctx.ms_mask & (1 << i)))
 		{
-			reg_val |= SI5351_CLKIN_ENABLE;
+			continue;
 		}
-		else
+
+		if(mask[0] & (1 << i))
 		{
-			reg_val &= ~(SI5351_CLKIN_ENABLE);
+			plan->pll[i] = SI5351_PLLA;
 		}
-		break;
-	case SI5351_FANOUT_XO:
-		if(enable)
+		else if(mask[1] & (1 << i))
 		{
-			reg_val |= SI5351_XTAL_ENABLE;
+			plan->pll[i] = SI5351_PLLB;
+		}
+		else if(plan_frac_ok(i, ctx.ms_freq[i], vco[0]))
+		{
+			plan->pll[i] = SI5351_PLLA;
+		}
+		else if(plan_frac_ok(i, ctx.ms_freq[i], vco[1]))
+		{
+			plan->pll[i] = SI5351_PLLB;
 		}
 		else
 		{
-			reg_val &= ~(SI5351_XTAL_ENABLE);
+			plan->failed |= (1 << i);
+			continue;
 		}
-		break;
-	case SI5351_FANOUT_MS:
-		if(enable)
+		plan->pll_freq[plan->pll[i]] = vco[plan->pll[i]];
+	}
+
+	for(a = 0; a < 2; a++)
+	{
+		if(plan->pll_freq[a] == 0)
 		{
-			reg_val |= SI5351_MULTISYNTH_ENABLE;
+			continue;
+		}
+		plan->pll_freq[a] = vco[a];
+		v = pll_calc((enum si5351_pll)a, vco[a], &reg, ref_correction[a == 0 ? plla_ref_osc : pllb_ref_osc], 0);
+		vco[a] = v;
+		plan->pll_int[a] = (reg.p2 == 0 && (reg.p1 & 0x7F) == 0) ? 1 : 0;
+	}
+
+	for(i = 0; i < 8; i++)
+	{
+		if(!(ctx.ms_mask & (1 << i)) || (plan->failed & (1 << i)))
+		{
+			continue;
+		}
+
+		v = vco[plan->pll[i]];
+		if(mask[plan->pll[i]] & (1 << i))
+		{
+			div = plan->pll_freq[plan->pll[i]] / ctx.ms_freq[i];
+			plan->ms_div[i] = div;
+			plan->achieved[i] = (v / div) >> plan->r_div[i];
 		}
 		else
 		{
-			reg_val &= ~(SI5351_MULTISYNTH_ENABLE);
+			// Output of the fractional divider, from its P1/P2/P3 values
+			multisynth_calc(ctx.ms_freq[i], v, &reg);
+			plan->achieved[i] = ((v * 128 * reg.p3) / (((uint64_t)reg.p1 + 512) * reg.p3 + reg.p2)) >> plan->r_div[i];
+		}
+
+		tol = (tolerance != NULL) ? tolerance[i] : SI5351_FREQ_MULT;
+		err = (plan->achieved[i] > plan->freq[i]) ? plan->achieved[i] - plan->freq[i] : plan->freq[i] - plan->achieved[i];
+		if(err > tol)
+		{
+			plan->failed |= (1 << i);
 		}
-		break;
 	}
 
-	si5351_write(SI5351_FANOUT_ENABLE, reg_val);
+	return plan->failed;
 }
 
 /*
- * set_pll_input(enum si5351_pll pll, enum si5351_pll_input input)
+ * apply_plan(const struct Si5351Plan *plan)
  *
- * pll - Which PLL to use as the source
- *     (use the si5351_pll enum)
- * input - Which reference oscillator to use as PLL input
- *     (use the si5351_pll_input enum)
+ * Configure the whole chip from a plan made by plan_outputs(), in a
+ * single transaction. Outputs with a frequency of 0 and outputs that
+ * could not be planned are disabled. The PLLs in use are reset once, at
+ * the end.
  *
- * Set the desired reference oscillator source for the given PLL.
+ * Returns 0 on success, or the last non-zero endTransmission() status.
  */
-void Si5351::set_pll_input(enum si5351_pll pll, enum si5351_pll_input input)
+uint8_t Si5351::apply_plan(const struct Si5351Plan *plan)
 {
-	uint8_t reg_val;
-	reg_val = si5351_read(SI5351_PLL_INPUT_SOURCE);
+	SI5351_API_SCOPE(SI5351_API_APPLY_PLAN);
 
-	// Clear the bits first
-	//reg_val &= ~(SI5351_CLKIN_DIV_MASK);
+	struct Si5351RegSet ms_reg;
+	uint64_t ms_freq;
+	uint8_t i, div_by_4;
+	enum si5351_clock clk;
 
-	switch(pll)
+	begin_transaction();
+
+	for(i = 0; i < 2; i++)
 	{
-	case SI5351_PLLA:
-		if(input == SI5351_PLL_INPUT_CLKIN)
+		if(plan->pll_freq[i] != 0)
 		{
-			reg_val |= SI5351_PLLA_SOURCE;
-			reg_val |= clkin_div;
-			plla_ref_osc = SI5351_PLL_INPUT_CLKIN;
+			set_pll(plan->pll_freq[i], (enum si5351_pll)i);
+			set_fb_int((enum si5351_pll)i, plan->pll_int[i]);
 		}
-		else
+	}
+
+	for(i = 0; i < 8; i++)
+	{
+		clk = (enum si5351_clock)i;
+
+		if(plan->freq[i] == 0 || (plan->failed & (1 << i)))
 		{
-			reg_val &= ~(SI5351_PLLA_SOURCE);
-			plla_ref_osc = SI5351_PLL_INPUT_XO;
+			output_enable(clk, 0);
+			clk_freq[i] = 0;
+			continue;
 		}
-		break;
-	case SI5351_PLLB:
-		if(input == SI5351_PLL_INPUT_CLKIN)
+
+		if(plan->source[i] == SI5351_CLK_SRC_XTAL || plan->source[i] == SI5351_CLK_SRC_CLKIN)
 		{
-			reg_val |= SI5351_PLLB_SOURCE;
-			reg_val |= clkin_div;
-			pllb_ref_osc = SI5351_PLL_INPUT_CLKIN;
+			set_clock_fanout((plan->source[i] == SI5351_CLK_SRC_XTAL) ? SI5351_FANOUT_XO : SI5351_FANOUT_CLKIN, 1);
+			set_clock_source(clk, plan->source[i]);
+			ms_div(clk, SI5351_OUTPUT_CLK_DIV_1, 0);
 		}
 		else
 		{
-			reg_val &= ~(SI5351_PLLB_SOURCE);
-			pllb_ref_osc = SI5351_PLL_INPUT_XO;
+			set_ms_source(clk, plan->pll[i]);
+			set_clock_source(clk, SI5351_CLK_SRC_MS);
+
+			ms_freq = plan->freq[i] << plan->r_div[i];
+			if(i <= SI5351_CLK5)
+			{
+				div_by_4 = (ms_freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT) ? 1 : 0;
+				multisynth_calc(ms_freq, plan->pll_freq[plan->pll[i]], &ms_reg);
+				set_ms(clk, ms_reg, (plan->ms_div[i] % 2 == 0 && plan->ms_div[i] != 0) ? 1 : 0, plan->r_div[i], div_by_4);
+			}
+			else
+			{
+				multisynth67_calc(ms_freq, plan->pll_freq[plan->pll[i]], &ms_reg);
+				set_ms(clk, ms_reg, 0, plan->r_div[i], 0);
+			}
 		}
-		break;
-	default:
-		return;
+
+		output_enable(clk, 1);
+		clk_first_set[i] = true;
+		clk_freq[i] = plan->freq[i];
 	}
 
-	si5351_write(SI5351_PLL_INPUT_SOURCE, reg_val);
+	for(i = 0; i < 2; i++)
+	{
+		if(plan->pll_freq[i] != 0)
+		{
+			pll_reset((enum si5351_pll)i);
+		}
+	}
 
-	set_pll(plla_freq, SI5351_PLLA);
-	set_pll(pllb_freq, SI5351_PLLB);
+	return commit();
 }
 
 /*
- * set_vcxo(uint64_t pll_freq, uint8_t ppm)
+ * compile_tones(enum si5351_clock clk, uint64_t base_freq, uint64_t spacing, uint8_t count, struct Si5351FreqStep *tones)
  *
- * pll_freq - Desired PLL base frequency in Hz * 100
- * ppm - VCXO pull limit in ppm
+ * Precompute the Multisynth register images for a set of equally spaced
+ * tones, for symbol playback with start_symbols(). All of the tones
+ * share one span of changed bytes, so that any tone can follow any
+ * other with a single short burst.
  *
- * Set the parameters for the VCXO on the Si5351B.
+ * As with compile_freq_list(), the PLL must not be changed between
+ * compiling the tones and playing the symbols. For the finest tone
+ * placement, select SI5351_FRAC_BEST_RATIONAL with set_frac_solver()
+ * before compiling.
+ *
+ * clk - Clock output (CLK0 through CLK5 only)
+ *   (use the si5351_clock enum)
+ * base_freq - Frequency of tone 0 in Hz * 100, no higher than 100 MHz
+ * spacing - Tone spacing in Hz * 100
+ * count - Number of tones
+ * tones - Array of count entries to hold the compiled tones
+ *
+ * Returns the number of tones compiled, which is less than count if a
+ * tone is out of range.
  */
-void Si5351::set_vcxo(uint64_t pll_freq, uint8_t ppm)
+uint8_t Si5351::compile_tones(enum si5351_clock clk, uint64_t base_freq, uint64_t spacing, uint8_t count, struct Si5351FreqStep *tones)
 {
-	struct Si5351RegSet pll_reg;
-	uint64_t vcxo_param;
+	uint8_t n, i, compiled;
+	uint8_t first = SI5351_PARAMETERS_LENGTH;
+	uint8_t last = 0;
 
-	// Bounds check
-	if(ppm < SI5351_VCXO_PULL_MIN)
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5)
 	{
-		ppm = SI5351_VCXO_PULL_MIN;
+		return 0;
 	}
 
-	if(ppm > SI5351_VCXO_PULL_MAX)
+	for(n = 0; n < count; n++)
 	{
-		ppm = SI5351_VCXO_PULL_MAX;
+		if(calc_freq_step(clk, base_freq + spacing * n, &tones[n]))
+		{
+			break;
+		}
 	}
+	compiled = n;
 
-	// Set PLLB params
-	vcxo_param = pll_calc(SI5351_PLLB, pll_freq, &pll_reg, ref_correction[pllb_ref_osc], 1);
+	// Widen the span to cover every byte that differs between any tones
+	for(n = 1; n < compiled; n++)
+	{
+		for(i = 0; i < SI5351_PARAMETERS_LENGTH; i++)
+		{
+			if(tones[n].params[i] != tones[0].params[i])
+			{
+				if(i < first)
+				{
+					first = i;
+				}
+				if(i > last)
+				{
+					last = i;
+				}
+			}
+		}
+	}
 
-	// Derive the register values to write
+	for(n = 0; n < compiled; n++)
+	{
+		tones[n].first = (first == SI5351_PARAMETERS_LENGTH) ? 0 : first;
+		tones[n].len = (first == SI5351_PARAMETERS_LENGTH) ? 0 : last - first + 1;
+	}
 
-	// Prepare an array for parameters to be written to
-	uint8_t *params = new uint8_t[20];
-	uint8_t i = 0;
-	uint8_t temp;
+	return compiled;
+}
 
-	// Registers 26-27
-	temp = ((pll_reg.p3 >> 8) & 0xFF);
-	params[i++] = temp;
+/*
+ * start_symbols(struct Si5351Symbols *sym, enum si5351_clock clk, const struct Si5351FreqStep *tones, const uint8_t *symbols, uint16_t count, uint32_t period_ns)
+ *
+ * Start playing a sequence of symbols from a tone table compiled with
+ * compile_tones(). The first symbol is written right away; the rest are
+ * sent by symbol_tick(). Symbol edges are scheduled from the start time
+ * in nanoseconds, so they do not drift over a long transmission.
+ *
+ * sym - Playback state, kept by the caller
+ * clk - Clock output the tones were compiled for
+ *   (use the si5351_clock enum)
+ * tones - Compiled tone table
+ * symbols - Array of tone numbers, one per symbol
+ * count - Number of symbols
+ * period_ns - Symbol period in nanoseconds (682666667 for WSPR)
+ *
+ * The sym struct and the tones and symbols arrays must stay in scope
+ * until playback ends.
+ */
+void Si5351::start_symbols(struct Si5351Symbols *sym, enum si5351_clock clk, const struct Si5351FreqStep *tones, const uint8_t *symbols, uint16_t count, uint32_t period_ns)
+{
+	SI5351_API_SCOPE(SI5351_API_SYMBOLS);
 
-	temp = (uint8_t)(pll_reg.p3  & 0xFF);
-	params[i++] = temp;
+	sym->count = 0;
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5 || count == 0)
+	{
+		return;
+	}
+
+	sym->clk = clk;
+	sym->tones = tones;
+	sym->data = symbols;
+	sym->period_us = period_ns / 1000;
+	sym->period_ns = period_ns % 1000;
+	sym->ns_acc = 0;
+	sym->stats.symbols = 1;
+	sym->stats.min_late_us = 0;
+	sym->stats.max_late_us = 0;
+
+	// Enable the output on first use, as set_freq() does
+	if(clk_first_set[(uint8_t)clk] == false)
+	{
+		output_enable(clk, 1);
+		clk_first_set[(uint8_t)clk] = true;
+	}
+	set_int(clk, 0);
+
+	si5351_write_bulk(SI5351_CLK0_PARAMETERS + (clk * 8), SI5351_PARAMETERS_LENGTH,
+		(uint8_t *)tones[symbols[0]].params);
+
+	sym->edge = micros();
+	sym->index = 1;
+	sym->count = count;
+}
+
+/*
+ * symbol_tick(struct Si5351Symbols *sym)
+ *
+ * sym - Playback state passed to start_symbols()
+ *
+ * Call as often as possible (at least several times per symbol) while
+ * symbols are playing. When the next symbol edge is due, its tone is
+ * written as one burst of the precomputed changed bytes, with no math
+ * and no register reads.
+ *
+ * Returns 1 while symbols are still playing, 0 once the last symbol
+ * has been sent.
+ */
+uint8_t Si5351::symbol_tick(struct Si5351Symbols *sym)
+{
+	SI5351_API_SCOPE(SI5351_API_SYMBOLS);
+
+	uint32_t now, late, next;
+	const struct Si5351FreqStep *tone;
+
+	if(sym->index >= sym->count)
+	{
+		return 0;
+	}
+
+	// Scheduled time of the next edge, carrying the sub-microsecond part
+	next = sym->edge + sym->period_us;
+	if(sym->ns_acc + sym->period_ns >= 1000)
+	{
+		next++;
+	}
+
+	now = micros();
+	if((int32_t)(now - next) < 0)
+	{
+		return 1;
+	}
+
+	tone = &sym->tones[sym->data[sym->index]];
+	if(tone->len != 0)
+	{
+		si5351_write_bulk(SI5351_CLK0_PARAMETERS + (sym->clk * 8) + tone->first,
+			tone->len, (uint8_t *)&tone->params[tone->first]);
+	}
+
+	late = now - next;
+	if(sym->stats.symbols == 1 || late < sym->stats.min_late_us)
+	{
+		sym->stats.min_late_us = late;
+	}
+	if(late > sym->stats.max_late_us)
+	{
+		sym->stats.max_late_us = late;
+	}
+	sym->stats.symbols++;
+
+	sym->edge = next;
+	sym->ns_acc += sym->period_ns;
+	if(sym->ns_acc >= 1000)
+	{
+		sym->ns_acc -= 1000;
+	}
+	sym->index++;
+
+	return (sym->index < sym->count) ? 1 : 0;
+}
+
+/*
+ * stop_symbols(struct Si5351Symbols *sym)
+ *
+ * sym - Playback state passed to start_symbols()
+ *
+ * Stop symbol playback. The output stays on the last tone sent.
+ */
+void Si5351::stop_symbols(struct Si5351Symbols *sym)
+{
+	sym->count = 0;
+	sym->index = 0;
+}
+
+/*
+ * get_symbol_stats(const struct Si5351Symbols *sym, struct Si5351SymbolStats *stats)
+ *
+ * sym - Playback state passed to start_symbols()
+ * stats - Pointer to the struct that receives the timing of the
+ *   present or last symbol playback
+ *
+ * min_late_us and max_late_us are the smallest and largest delays
+ * between a scheduled symbol edge and the start of its register write,
+ * as seen by symbol_tick(). Their difference is the symbol edge jitter.
+ */
+void Si5351::get_symbol_stats(const struct Si5351Symbols *sym, struct Si5351SymbolStats *stats)
+{
+	*stats = sym->stats;
+}
+
+/*
+ * start_sweep(struct Si5351Sweep *sweep, enum si5351_clock clk, uint64_t start, uint64_t stop, uint16_t steps, enum si5351_sweep_mode mode)
+ *
+ * Start a frequency sweep on a clock output. The start frequency is set
+ * right away; each call to sweep_step() then moves to the next one.
+ * The state of the sweep is kept in a Si5351Sweep struct that the
+ * caller provides.
+ *
+ * sweep - Sweep state, which must stay in place until the sweep ends
+ * clk - Clock output to sweep (CLK0 through CLK5)
+ *   (use the si5351_clock enum)
+ * start - First frequency in Hz * 100
+ * stop - Last frequency in Hz * 100, above or below start
+ * steps - Number of frequencies, including start and stop (at least 2)
+ * mode - SI5351_SWEEP_LINEAR for equal frequency steps, or
+ *   SI5351_SWEEP_LOG for equal frequency ratios
+ *
+ * The whole sweep must lie between SI5351_CLKOUT_MIN_FREQ and
+ * SI5351_MULTISYNTH_SHARE_MAX, so that the PLL stays where it is, and in
+ * SI5351_SWEEP_LOG mode no step may more than double or halve the
+ * frequency. The output must not be on a PLL in tuning mode.
+ *
+ * Returns 0 on success, or 1 if the sweep cannot be done.
+ */
+uint8_t Si5351::start_sweep(struct Si5351Sweep *sweep, enum si5351_clock clk, uint64_t start, uint64_t stop, uint16_t steps, enum si5351_sweep_mode mode)
+{
+	SI5351_API_SCOPE(SI5351_API_SWEEP);
+
+	uint64_t lo, hi, span, rem, limit, r_lo, r_hi, r_mid;
+
+	sweep->steps = 0;
+	sweep->index = 0;
+	if((uint8_t)clk > (uint8_t)SI5351_CLK5 || steps < 2 || pll_tuning[pll_assignment[clk]])
+	{
+		return 1;
+	}
+
+	sweep->down = (stop < start) ? 1 : 0;
+	lo = sweep->down ? stop : start;
+	hi = sweep->down ? start : stop;
+	if(lo < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT || hi > SI5351_MULTISYNTH_SHARE_MAX * SI5351_FREQ_MULT)
+	{
+		return 1;
+	}
+
+	sweep->pll_freq = (pll_assignment[clk] == SI5351_PLLA) ? plla_freq : pllb_freq;
+	if(sweep->pll_freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT ||
+		sweep->pll_freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+	{
+		return 1;
+	}
+
+	if(mode == SI5351_SWEEP_LINEAR)
+	{
+		// Bresenham-style, so step k lands exactly on start + k * span / (steps - 1)
+		sweep->inc = (hi - lo) / (steps - 1);
+		sweep->inc_rem = (hi - lo) % (steps - 1);
+		sweep->err = 0;
+	}
+	else
+	{
+		if(steps - 1 < 16 && (lo << (steps - 1)) < hi)
+		{
+			return 1;
+		}
+
+		// The span hi / lo in Q32, which is below 2^15
+		span = (uint64_t)udiv_bounded(hi, lo, 15, &rem) << 32;
+		span |= (uint64_t)udiv_bounded(rem << 16, lo, 16, &rem) << 16;
+		span |= udiv_bounded(rem << 16, lo, 16, NULL);
+
+		// Find the Q32 ratio per step whose (steps - 1)th power is
+		// closest to the span, by bisection between 1 and 2. An error
+		// here grows steps - 1 times over the sweep, so it is worth
+		// taking the time once.
+		r_lo = 1ULL << 32;
+		r_hi = (1ULL << 33) - 1;
+		while(r_hi - r_lo > 1)
+		{
+			r_mid = r_lo + ((r_hi - r_lo) >> 1);
+			if(pow_q32(r_mid, steps - 1, span) <= span)
+			{
+				r_lo = r_mid;
+			}
+			else
+			{
+				r_hi = r_mid;
+			}
+		}
+		limit = span + (span >> 4);
+		if(pow_q32(r_hi, steps - 1, limit) - span < span - pow_q32(r_lo, steps - 1, limit))
+		{
+			r_lo = r_hi;
+		}
+
+		// Each step adds this fraction of the frequency, or going down
+		// takes away 1 - 1 / ratio of it, in Q32
+		r_lo -= 1ULL << 32;
+		sweep->ratio = sweep->down ?
+			udiv_bounded((r_lo << 32) + ((r_lo + (1ULL << 32)) >> 1), r_lo + (1ULL << 32), 32, NULL) :
+			(uint32_t)r_lo;
+	}
+
+	set_freq(start, clk);
+	sweep_solve(sweep, start);
+
+	sweep->clk = clk;
+	sweep->mode = mode;
+	sweep->freq = start;
+	sweep->acc = start << 16;
+	sweep->stop = stop;
+	sweep->index = 1;
+	sweep->steps = steps;
+
+	return 0;
+}
+
+/*
+ * sweep_step(struct Si5351Sweep *sweep)
+ *
+ * Move a sweep started with start_sweep() on to its next frequency.
+ *
+ * sweep - Sweep state passed to start_sweep()
+ *
+ * Between steps, the Multisynth divider is carried forward with a few
+ * multiplications and additions instead of being worked out again with
+ * 64-bit divisions: the change in the divider is predicted from the last
+ * two steps and then corrected. A full solve is only done when the
+ * output R divider has to change. Only the Multisynth registers that
+ * differ from the last step are written, and the PLL is not reset, so
+ * the output stays phase-continuous. The registers are the same as
+ * set_freq() would write with the default fractional solver.
+ *
+ * Returns 1 while there are steps left, 0 once the stop frequency has
+ * been set (or if no sweep is running).
+ */
+uint8_t Si5351::sweep_step(struct Si5351Sweep *sweep)
+{
+	SI5351_API_SCOPE(SI5351_API_SWEEP);
+
+	struct Si5351RegSet ms_reg;
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	uint8_t base = SI5351_CLK0_PARAMETERS + (sweep->clk * 8);
+	uint64_t freq = sweep->freq;
+	uint64_t d, rem;
+
+	if(sweep->index >= sweep->steps)
+	{
+		return 0;
+	}
+
+	if(sweep->index == sweep->steps - 1)
+	{
+		freq = sweep->stop;
+	}
+	else if(sweep->mode == SI5351_SWEEP_LINEAR)
+	{
+		d = sweep->inc;
+		sweep->err += sweep->inc_rem;
+		if(sweep->err >= (uint32_t)(sweep->steps - 1))
+		{
+			sweep->err -= sweep->steps - 1;
+			d++;
+		}
+		freq = sweep->down ? freq - d : freq + d;
+	}
+	else
+	{
+		// The exact frequency is carried with 16 more fractional bits,
+		// so that rounding does not build up from step to step
+		d = mul_q32(sweep->acc, sweep->ratio);
+		sweep->acc = sweep->down ? sweep->acc - d : sweep->acc + d;
+		freq = (sweep->acc + (1ULL << 15)) >> 16;
+		if(sweep->down ? (freq < sweep->stop) : (freq > sweep->stop))
+		{
+			freq = sweep->stop;
+		}
+	}
+
+	if(!sweep_advance(sweep, freq))
+	{
+		sweep_solve(sweep, freq);
+	}
+
+	// Same parameters as multisynth_calc() with RFRAC_DENOM
+	if(sweep->b == 0)
+	{
+		ms_reg.p1 = 128 * sweep->a - 512;
+		ms_reg.p2 = 0;
+		ms_reg.p3 = 1;
+	}
+	else
+	{
+		ms_reg.p1 = 128 * sweep->a + udiv_bounded((uint64_t)sweep->b * 128, RFRAC_DENOM, 7, &rem) - 512;
+		ms_reg.p2 = (uint32_t)rem;
+		ms_reg.p3 = RFRAC_DENOM;
+	}
+	pack_params(&ms_reg, params);
+	params[2] |= reg_cache[base + 2] & ~(0x7F);
+	params[2] |= (sweep->r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+	write_regs(base, SI5351_PARAMETERS_LENGTH, params, 1);
+
+	clk_freq[(uint8_t)sweep->clk] = freq;
+	sweep->freq = freq;
+	sweep->index++;
+
+	return (sweep->index < sweep->steps) ? 1 : 0;
+}
+
+/*
+ * stop_sweep(struct Si5351Sweep *sweep)
+ *
+ * Stop a sweep. The output stays on the last frequency set.
+ *
+ * sweep - Sweep state passed to start_sweep()
+ */
+void Si5351::stop_sweep(struct Si5351Sweep *sweep)
+{
+	sweep->steps = 0;
+	sweep->index = 0;
+}
+
+/*
+ * set_pll(uint64_t pll_freq, enum si5351_pll target_pll)
+ *
+ * Set the specified PLL to a specific oscillation frequency
+ *
+ * pll_freq - Desired PLL frequency in Hz * 100
+ * target_pll - Which PLL to set
+ *     (use the si5351_pll enum)
+ */
+void Si5351::set_pll(uint64_t pll_freq, enum si5351_pll target_pll)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_PLL);
+
+  struct Si5351RegSet pll_reg;
+
+	if(target_pll == SI5351_PLLA)
+	{
+		pll_calc(SI5351_PLLA, pll_freq, &pll_reg, ref_correction[plla_ref_osc], 0);
+	}
+	else
+	{
+		pll_calc(SI5351_PLLB, pll_freq, &pll_reg, ref_correction[pllb_ref_osc], 0);
+	}
+
+  // Derive the register values to write
+  uint8_t params[SI5351_PARAMETERS_LENGTH];
+  pack_params(&pll_reg, params);
+
+  // Write the parameters
+  if(target_pll == SI5351_PLLA)
+  {
+    si5351_write_bulk(SI5351_PLLA_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
+		plla_freq = pll_freq;
+  }
+  else if(target_pll == SI5351_PLLB)
+  {
+    si5351_write_bulk(SI5351_PLLB_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
+		pllb_freq = pll_freq;
+  }
+}
+
+/*
+ * set_ms(enum si5351_clock clk, struct Si5351RegSet ms_reg, uint8_t int_mode, uint8_t r_div, uint8_t div_by_4)
+ *
+ * Set the specified multisynth parameters. Not normally needed, but public for advanced users.
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * int_mode - Set integer mode
+ *  Set to 1 to enable, 0 to disable
+ * r_div - Desired r_div ratio
+ * div_by_4 - Set Divide By 4 mode
+ *   Set to 1 to enable, 0 to disable
+ */
+void Si5351::set_ms(enum si5351_clock clk, struct Si5351RegSet ms_reg, uint8_t int_mode, uint8_t r_div, uint8_t div_by_4)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_MS);
+
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	uint8_t temp = 0;
+
+	if((uint8_t)clk <= (uint8_t)SI5351_CLK5)
+	{
+		pack_params(&ms_reg, params);
+
+		// Register 44 for CLK0 also holds the R divider and DIVBY4 bits,
+		// so ms_div() is only needed for MS6 and MS7
+		params[2] |= reg_cache[(SI5351_CLK0_PARAMETERS + 2) + (clk * 8)] & ~(0x7F);
+		params[2] |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+		if(div_by_4 != 0)
+		{
+			params[2] |= (SI5351_OUTPUT_CLK_DIVBY4);
+		}
+	}
+	else
+	{
+		// MS6 and MS7 only use one register
+		temp = ms_reg.p1;
+	}
+
+	// Write the parameters
+	switch(clk)
+	{
+		case SI5351_CLK0:
+			write_regs(SI5351_CLK0_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK1:
+			write_regs(SI5351_CLK1_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK2:
+			write_regs(SI5351_CLK2_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK3:
+			write_regs(SI5351_CLK3_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK4:
+			write_regs(SI5351_CLK4_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK5:
+			write_regs(SI5351_CLK5_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, delta_write);
+			set_int(clk, int_mode);
+			break;
+		case SI5351_CLK6:
+			write_regs(SI5351_CLK6_PARAMETERS, 1, &temp, delta_write);
+			ms_div(clk, r_div, div_by_4);
+			break;
+		case SI5351_CLK7:
+			write_regs(SI5351_CLK7_PARAMETERS, 1, &temp, delta_write);
+			ms_div(clk, r_div, div_by_4);
+			break;
+	}
+}
+
+/*
+ * output_enable(enum si5351_clock clk, uint8_t enable)
+ *
+ * Enable or disable a chosen output
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * enable - Set to 1 to enable, 0 to disable
+ */
+void Si5351::output_enable(enum si5351_clock clk, uint8_t enable)
+{
+	SI5351_API_SCOPE(SI5351_API_OUTPUT_ENABLE);
+
+  uint8_t reg_val;
+
+  reg_val = reg_cache[SI5351_OUTPUT_ENABLE_CTRL];
+
+  if(enable == 1)
+  {
+    reg_val &= ~(1<<(uint8_t)clk);
+  }
+  else
+  {
+    reg_val |= (1<<(uint8_t)clk);
+  }
+
+  si5351_write(SI5351_OUTPUT_ENABLE_CTRL, reg_val);
+}
+
+/*
+ * drive_strength(enum si5351_clock clk, enum si5351_drive drive)
+ *
+ * Sets the drive strength of the specified clock output
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * drive - Desired drive level
+ *   (use the si5351_drive enum)
+ */
+void Si5351::drive_strength(enum si5351_clock clk, enum si5351_drive drive)
+{
+	SI5351_API_SCOPE(SI5351_API_DRIVE_STRENGTH);
+
+  uint8_t reg_val;
+  const uint8_t mask = 0x03;
+
+  reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+  reg_val &= ~(mask);
+
+  switch(drive)
+  {
+  case SI5351_DRIVE_2MA:
+    reg_val |= 0x00;
+    break;
+  case SI5351_DRIVE_4MA:
+   reg_val |= 0x01;
+    break;
+  case SI5351_DRIVE_6MA:
+    reg_val |= 0x02;
+    break;
+  case SI5351_DRIVE_8MA:
+    reg_val |= 0x03;
+    break;
+  default:
+    break;
+  }
+
+  si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+}
+
+/*
+ * update_status(void)
+ *
+ * Call this to update the status structs, then access them
+ * via the dev_status and dev_int_status global members.
+ *
+ * See the header file for the struct definitions. These
+ * correspond to the flag names for registers 0 and 1 in
+ * the Si5351 datasheet.
+ */
+void Si5351::update_status(void)
+{
+	SI5351_API_SCOPE(SI5351_API_UPDATE_STATUS);
+
+	uint8_t status[2] = {0, 0};
+
+	// Registers 0 and 1 are adjacent, so read them in one go
+	si5351_read_bulk(SI5351_DEVICE_STATUS, 2, status);
+	update_sys_status(status[0], &dev_status);
+	update_int_status(status[1], &dev_int_status);
+}
+
+/*
+ * enable_events(uint8_t events)
+ *
+ * events - Status conditions that pull the INTB pin low, as an OR of
+ *   SI5351_STATUS_SYS_INIT, SI5351_STATUS_LOL_B, SI5351_STATUS_LOL_A,
+ *   SI5351_STATUS_LOS and SI5351_STATUS_LOS_XTAL, or 0 for none
+ *
+ * Program the interrupt mask register, so that the Si5351 signals only
+ * the given events on its INTB pin (an open-drain output, active low).
+ * INTB is only brought out on the 20-pin packages.
+ */
+void Si5351::enable_events(uint8_t events)
+{
+	SI5351_API_SCOPE(SI5351_API_ENABLE_EVENTS);
+
+	si5351_write(SI5351_INTERRUPT_MASK, ~events & SI5351_EVENT_ALL);
+}
+
+/*
+ * set_event_callback(uint8_t event, void (*callback)(uint8_t))
+ *
+ * event - One of the SI5351_STATUS_* event bits
+ * callback - Function to call when service_events() finds the event,
+ *   or NULL for none. It is passed 1 if the condition is still present
+ *   (e.g. the PLL is still out of lock), or 0 if it has already cleared.
+ */
+void Si5351::set_event_callback(uint8_t event, void (*callback)(uint8_t))
+{
+	for(uint8_t i = 0; i < SI5351_EVENT_COUNT; i++)
+	{
+		if(event == (SI5351_STATUS_SYS_INIT >> i))
+		{
+			event_callback[i] = callback;
+		}
+	}
+}
+
+/*
+ * set_int_pin(uint8_t (*pin_read)(void))
+ *
+ * pin_read - Function that returns the level of the pin wired to INTB,
+ *   or NULL if there is none
+ *
+ * With a pin hook, service_events() reads the pin first and only goes
+ * to the Si5351 while INTB is low. This suits a sketch that cannot spare
+ * an interrupt for INTB; otherwise call int_notify() from the handler.
+ */
+void Si5351::set_int_pin(uint8_t (*pin_read)(void))
+{
+	int_pin = pin_read;
+}
+
+/*
+ * int_notify(void)
+ *
+ * Mark that INTB has fired. This only sets a flag, so it is safe to call
+ * from an interrupt handler attached to the falling edge of INTB. The
+ * bus work is left to the next call of service_events().
+ */
+void Si5351::int_notify(void)
+{
+	event_pending = 1;
+}
+
+/*
+ * service_events(void)
+ *
+ * Call this from the main loop. If int_notify() was called, or the pin
+ * hook set with set_int_pin() shows INTB low, read registers 0 and 1 in
+ * one burst, update dev_status and dev_int_status, clear the sticky
+ * flags that were read, and call the callback of each flagged event
+ * that enable_events() has not masked off. Otherwise return at once
+ * without touching the bus.
+ *
+ * An event whose condition persists sets its sticky flag again, and
+ * keeps INTB low; mask it with enable_events() until it has been dealt
+ * with.
+ *
+ * Returns the SI5351_STATUS_* bits of the enabled events that were
+ * serviced.
+ */
+uint8_t Si5351::service_events(void)
+{
+	SI5351_API_SCOPE(SI5351_API_SERVICE_EVENTS);
+
+	uint8_t status[2];
+	uint8_t sticky, clear;
+
+	if(!event_pending && (int_pin == NULL || int_pin() != 0))
+	{
+		return 0;
+	}
+	event_pending = 0;
+
+	if(i2c_read_bulk(SI5351_DEVICE_STATUS, 2, status) != 0)
+	{
+		// Try again on the next call
+		event_pending = 1;
+		return 0;
+	}
+	update_sys_status(status[0], &dev_status);
+	update_int_status(status[1], &dev_int_status);
+
+	// Sticky flags are cleared by writing 0 to them. Register 1 is not
+	// shadowed, so this goes straight to the bus even in a transaction.
+	// Only the flags read here are cleared, so that one that is set
+	// in the meantime stays set for the next call.
+	sticky = status[1] & SI5351_EVENT_ALL;
+	if(sticky != 0)
+	{
+		clear = (uint8_t)~sticky;
+		i2c_write_bulk(SI5351_INTERRUPT_STATUS, 1, &clear);
+	}
+
+	// Events masked off with enable_events() are cleared but not
+	// passed on. The mask register is all enabled after a reset.
+	if(reg_valid[SI5351_INTERRUPT_MASK >> 3] & (1 << (SI5351_INTERRUPT_MASK & 7)))
+	{
+		sticky &= ~reg_cache[SI5351_INTERRUPT_MASK];
+	}
+
+	for(uint8_t i = 0; i < SI5351_EVENT_COUNT; i++)
+	{
+		uint8_t event = SI5351_STATUS_SYS_INIT >> i;
+
+		if((sticky & event) && event_callback[i] != NULL)
+		{
+			event_callback[i]((status[0] & event) ? 1 : 0);
+		}
+	}
+
+	return sticky;
+}
+
+/*
+ * set_correction(int32_t corr, enum si5351_pll_input ref_osc)
+ *
+ * corr - Correction factor in ppb
+ * ref_osc - Desired reference oscillator
+ *     (use the si5351_pll_input enum)
+ *
+ * Use this to set the oscillator correction factor.
+ * This value is a signed 32-bit integer of the
+ * parts-per-billion value that the actual oscillation
+ * frequency deviates from the specified frequency.
+ *
+ * The frequency calibration is done as a one-time procedure.
+ * Any desired test frequency within the normal range of the
+ * Si5351 should be set, then the actual output frequency
+ * should be measured as accurately as possible. The
+ * difference between the measured and specified frequencies
+ * should be calculated in Hertz, then multiplied by 10 in
+ * order to get the parts-per-billion value.
+ *
+ * Since the Si5351 itself has an intrinsic 0 PPM error, this
+ * correction factor is good across the entire tuning range of
+ * the Si5351. Once this calibration is done accurately, it
+ * should not have to be done again for the same Si5351 and
+ * crystal.
+ */
+void Si5351::set_correction(int32_t corr, enum si5351_pll_input ref_osc)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CORRECTION);
+
+	ref_correction[(uint8_t)ref_osc] = corr;
+	update_ref_freq_corr(ref_osc);
+
+	// Recalculate and set PLL freqs based on correction value
+	set_pll(plla_freq, SI5351_PLLA);
+	set_pll(pllb_freq, SI5351_PLLB);
+}
+
+/*
+ * set_phase(enum si5351_clock clk, uint8_t phase)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * phase - 7-bit phase word
+ *   (in units of VCO/4 period)
+ *
+ * Write the 7-bit phase register. This must be used
+ * with a user-set PLL frequency so that the user can
+ * calculate the proper tuning word based on the PLL period.
+ */
+void Si5351::set_phase(enum si5351_clock clk, uint8_t phase)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_PHASE);
+
+	// Mask off the upper bit since it is reserved
+	phase = phase & 0b01111111;
+
+	si5351_write(SI5351_CLK0_PHASE_OFFSET + (uint8_t)clk, phase);
+}
+
+/*
+ * get_correction(enum si5351_pll_input ref_osc)
+ *
+ * ref_osc - Desired reference oscillator
+ *     0: crystal oscillator (XO)
+ *     1: external clock input (CLKIN)
+ *
+ * Returns the oscillator correction factor stored
+ * in RAM.
+ */
+int32_t Si5351::get_correction(enum si5351_pll_input ref_osc)
+{
+	return ref_correction[(uint8_t)ref_osc];
+}
+
+/*
+ * pll_reset(enum si5351_pll target_pll)
+ *
+ * target_pll - Which PLL to reset
+ *     (use the si5351_pll enum)
+ *
+ * Apply a reset to the indicated PLL.
+ */
+void Si5351::pll_reset(enum si5351_pll target_pll)
+{
+	SI5351_API_SCOPE(SI5351_API_PLL_RESET);
+
+	if(target_pll == SI5351_PLLA)
+ 	{
+    	si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_A);
+	}
+	else if(target_pll == SI5351_PLLB)
+	{
+	    si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_B);
+	}
+}
+
+/*
+ * pll_reset_wait(enum si5351_pll target_pll, uint32_t timeout)
+ *
+ * target_pll - Which PLL to reset
+ *     (use the si5351_pll enum)
+ * timeout - Longest time to wait for lock, in us
+ *
+ * Apply a reset to the indicated PLL, then poll its loss of lock flag
+ * (LOL_A or LOL_B in register 0) until it clears. In asynchronous mode
+ * any queued writes are sent first. The lock time is measured from the
+ * end of the reset write to the status read that shows lock, so it is
+ * only as fine as one register read on the bus.
+ *
+ * Each call is added to the statistics returned by get_lock_stats().
+ *
+ * Returns the lock time in us, or SI5351_PLL_LOCK_FAILED if the PLL did
+ * not lock within the timeout or this is called inside a transaction.
+ */
+uint32_t Si5351::pll_reset_wait(enum si5351_pll target_pll, uint32_t timeout)
+{
+	SI5351_API_SCOPE(SI5351_API_PLL_RESET_WAIT);
+
+	struct Si5351LockStats *stats = &lock_stats[(uint8_t)target_pll];
+	uint8_t lol = (target_pll == SI5351_PLLA) ? SI5351_STATUS_LOL_A : SI5351_STATUS_LOL_B;
+	uint8_t status_reg;
+	uint32_t t0, lock_time;
+
+	if(txn_depth != 0)
+	{
+		return SI5351_PLL_LOCK_FAILED;
+	}
+
+	pll_reset(target_pll);
+	flush();
+	t0 = micros();
+
+	while(i2c_read_bulk(SI5351_DEVICE_STATUS, 1, &status_reg) != 0 || (status_reg & lol))
+	{
+		if(micros() - t0 >= timeout)
+		{
+			stats->timeouts++;
+			return SI5351_PLL_LOCK_FAILED;
+		}
+	}
+	lock_time = micros() - t0;
+
+	stats->locks++;
+	if(stats->locks == 1 || lock_time < stats->min_us)
+	{
+		stats->min_us = lock_time;
+	}
+	if(lock_time > stats->max_us)
+	{
+		stats->max_us = lock_time;
+	}
+	lock_total_us[(uint8_t)target_pll] += lock_time;
+	stats->mean_us = lock_total_us[(uint8_t)target_pll] / stats->locks;
+
+	return lock_time;
+}
+
+/*
+ * get_lock_stats(enum si5351_pll target_pll, struct Si5351LockStats *stats)
+ *
+ * target_pll - PLL to report on
+ *     (use the si5351_pll enum)
+ * stats - Pointer to the struct that receives the statistics
+ *
+ * Lock times measured by pll_reset_wait() since the object was created
+ * or since reset_lock_stats(). locks and timeouts count the resets that
+ * did and did not lock in time; min_us, max_us and mean_us cover the
+ * ones that locked. Use max_us to size the dwell after a PLL change.
+ */
+void Si5351::get_lock_stats(enum si5351_pll target_pll, struct Si5351LockStats *stats)
+{
+	*stats = lock_stats[(uint8_t)target_pll];
+}
+
+/*
+ * reset_lock_stats(void)
+ *
+ * Clear the lock time statistics of both PLLs.
+ */
+void Si5351::reset_lock_stats(void)
+{
+	memset(lock_stats, 0, sizeof(lock_stats));
+	memset(lock_total_us, 0, sizeof(lock_total_us));
+}
+
+/*
+ * set_ms_source(enum si5351_clock clk, enum si5351_pll pll)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * pll - Which PLL to use as the source
+ *     (use the si5351_pll enum)
+ *
+ * Set the desired PLL source for a multisynth.
+ */
+void Si5351::set_ms_source(enum si5351_clock clk, enum si5351_pll pll)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_MS_SOURCE);
+
+	uint8_t reg_val;
+
+	reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+
+	if(pll == SI5351_PLLA)
+	{
+		reg_val &= ~(SI5351_CLK_PLL_SELECT);
+	}
+	else if(pll == SI5351_PLLB)
+	{
+		reg_val |= SI5351_CLK_PLL_SELECT;
+	}
+
+	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+
+	pll_assignment[(uint8_t)clk] = pll;
+}
+
+/*
+ * set_int(enum si5351_clock clk, uint8_t int_mode)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * enable - Set to 1 to enable, 0 to disable
+ *
+ * Set the indicated multisynth into integer mode.
+ */
+void Si5351::set_int(enum si5351_clock clk, uint8_t enable)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_INT);
+
+	uint8_t reg_val;
+	reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+
+	if(enable == 1)
+	{
+		reg_val |= (SI5351_CLK_INTEGER_MODE);
+	}
+	else
+	{
+		reg_val &= ~(SI5351_CLK_INTEGER_MODE);
+	}
+
+	write_regs(SI5351_CLK0_CTRL + (uint8_t)clk, 1, &reg_val, delta_write);
+
+	// Integer mode indication
+	/*
+	switch(clk)
+	{
+	case SI5351_CLK0:
+		clk0_int_mode = enable;
+		break;
+	case SI5351_CLK1:
+		clk1_int_mode = enable;
+		break;
+	case SI5351_CLK2:
+		clk2_int_mode = enable;
+		break;
+	default:
+		break;
+	}
+	*/
+}
+
+/*
+ * set_clock_pwr(enum si5351_clock clk, uint8_t pwr)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * pwr - Set to 1 to enable, 0 to disable
+ *
+ * Enable or disable power to a clock output (a power
+ * saving feature).
+ */
+void Si5351::set_clock_pwr(enum si5351_clock clk, uint8_t pwr)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CLOCK_PWR);
+
+	uint8_t reg_val; //, reg;
+	reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+
+	if(pwr == 1)
+	{
+		reg_val &= 0b01111111;
+	}
+	else
+	{
+		reg_val |= 0b10000000;
+	}
+
+	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+}
+
+/*
+ * set_clock_invert(enum si5351_clock clk, uint8_t inv)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * inv - Set to 1 to enable, 0 to disable
+ *
+ * Enable to invert the clock output waveform.
+ */
+void Si5351::set_clock_invert(enum si5351_clock clk, uint8_t inv)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CLOCK_INVERT);
+
+	uint8_t reg_val;
+	reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+
+	if(inv == 1)
+	{
+		reg_val |= (SI5351_CLK_INVERT);
+	}
+	else
+	{
+		reg_val &= ~(SI5351_CLK_INVERT);
+	}
+
+	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+}
+
+/*
+ * set_clock_source(enum si5351_clock clk, enum si5351_clock_source src)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * src - Which clock source to use for the multisynth
+ *   (use the si5351_clock_source enum)
+ *
+ * Set the clock source for a multisynth (based on the options
+ * presented for Registers 16-23 in the Silicon Labs AN619 document).
+ * Choices are XTAL, CLKIN, MS0, or the multisynth associated with
+ * the clock output.
+ */
+void Si5351::set_clock_source(enum si5351_clock clk, enum si5351_clock_source src)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CLOCK_SOURCE);
+
+	uint8_t reg_val;
+	reg_val = reg_cache[SI5351_CLK0_CTRL + (uint8_t)clk];
+
+	// Clear the bits first
+	reg_val &= ~(SI5351_CLK_INPUT_MASK);
+
+	switch(src)
+	{
+	case SI5351_CLK_SRC_XTAL:
+		reg_val |= (SI5351_CLK_INPUT_XTAL);
+		break;
+	case SI5351_CLK_SRC_CLKIN:
+		reg_val |= (SI5351_CLK_INPUT_CLKIN);
+		break;
+	case SI5351_CLK_SRC_MS0:
+		if(clk == SI5351_CLK0)
+		{
+			return;
+		}
+
+		reg_val |= (SI5351_CLK_INPUT_MULTISYNTH_0_4);
+		break;
+	case SI5351_CLK_SRC_MS:
+		reg_val |= (SI5351_CLK_INPUT_MULTISYNTH_N);
+		break;
+	default:
+		return;
+	}
+
+	si5351_write(SI5351_CLK0_CTRL + (uint8_t)clk, reg_val);
+}
+
+/*
+ * set_clock_disable(enum si5351_clock clk, enum si5351_clock_disable dis_state)
+ *
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ * dis_state - Desired state of the output upon disable
+ *   (use the si5351_clock_disable enum)
+ *
+ * Set the state of the clock output when it is disabled. Per page 27
+ * of AN619 (Registers 24 and 25), there are four possible values: low,
+ * high, high impedance, and never disabled.
+ */
+void Si5351::set_clock_disable(enum si5351_clock clk, enum si5351_clock_disable dis_state)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CLOCK_DISABLE);
+
+	uint8_t reg_val, reg;
+
+	if (clk >= SI5351_CLK0 && clk <= SI5351_CLK3)
+	{
+		reg = SI5351_CLK3_0_DISABLE_STATE;
+	}
+	else if(clk >= SI5351_CLK4 && clk <= SI5351_CLK7)
+	{
+		reg = SI5351_CLK7_4_DISABLE_STATE;
+	}
+	else return;
+
+	reg_val = reg_cache[reg];
+
+	if (clk >= SI5351_CLK0 && clk <= SI5351_CLK3)
+	{
+		reg_val &= ~(0b11 << (clk * 2));
+		reg_val |= dis_state << (clk * 2);
+	}
+	else if(clk >= SI5351_CLK4 && clk <= SI5351_CLK7)
+	{
+		reg_val &= ~(0b11 << ((clk - 4) * 2));
+		reg_val |= dis_state << ((clk - 4) * 2);
+	}
+
+	si5351_write(reg, reg_val);
+}
+
+/*
+ * set_clock_fanout(enum si5351_clock_fanout fanout, uint8_t enable)
+ *
+ * fanout - Desired clock fanout
+ *   (use the si5351_clock_fanout enum)
+ * enable - Set to 1 to enable, 0 to disable
+ *
+ * Use this function to enable or disable the clock fanout options
+ * for individual clock outputs. If you intend to output the XO or
+ * CLKIN on the clock outputs, enable this first.
+ *
+ * By default, only the Multisynth fanout is enabled at startup.
+ */
+void Si5351::set_clock_fanout(enum si5351_clock_fanout fanout, uint8_t enable)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_CLOCK_FANOUT);
+
+	uint8_t reg_val;
+	reg_val = reg_cache[SI5351_FANOUT_ENABLE];
+
+	switch(fanout)
+	{
+	case SI5351_FANOUT_CLKIN:
+		if(enable)
+		{
+			reg_val |= SI5351_CLKIN_ENABLE;
+		}
+		else
+		{
+			reg_val &= ~(SI5351_CLKIN_ENABLE);
+		}
+		break;
+	case SI5351_FANOUT_XO:
+		if(enable)
+		{
+			reg_val |= SI5351_XTAL_ENABLE;
+		}
+		else
+		{
+			reg_val &= ~(SI5351_XTAL_ENABLE);
+		}
+		break;
+	case SI5351_FANOUT_MS:
+		if(enable)
+		{
+			reg_val |= SI5351_MULTISYNTH_ENABLE;
+		}
+		else
+		{
+			reg_val &= ~(SI5351_MULTISYNTH_ENABLE);
+		}
+		break;
+	}
+
+	si5351_write(SI5351_FANOUT_ENABLE, reg_val);
+}
+
+/*
+ * set_pll_input(enum si5351_pll pll, enum si5351_pll_input input)
+ *
+ * pll - Which PLL to use as the source
+ *     (use the si5351_pll enum)
+ * input - Which reference oscillator to use as PLL input
+ *     (use the si5351_pll_input enum)
+ *
+ * Set the desired reference oscillator source for the given PLL.
+ */
+void Si5351::set_pll_input(enum si5351_pll pll, enum si5351_pll_input input)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_PLL_INPUT);
+
+	uint8_t reg_val;
+	reg_val = reg_cache[SI5351_PLL_INPUT_SOURCE];
+
+	// Clear the bits first
+	//reg_val &= ~(SI5351_CLKIN_DIV_MASK);
+
+	switch(pll)
+	{
+	case SI5351_PLLA:
+		if(input == SI5351_PLL_INPUT_CLKIN)
+		{
+			reg_val |= SI5351_PLLA_SOURCE;
+			reg_val |= clkin_div;
+			plla_ref_osc = SI5351_PLL_INPUT_CLKIN;
+		}
+		else
+		{
+			reg_val &= ~(SI5351_PLLA_SOURCE);
+			plla_ref_osc = SI5351_PLL_INPUT_XO;
+		}
+		break;
+	case SI5351_PLLB:
+		if(input == SI5351_PLL_INPUT_CLKIN)
+		{
+			reg_val |= SI5351_PLLB_SOURCE;
+			reg_val |= clkin_div;
+			pllb_ref_osc = SI5351_PLL_INPUT_CLKIN;
+		}
+		else
+		{
+			reg_val &= ~(SI5351_PLLB_SOURCE);
+			pllb_ref_osc = SI5351_PLL_INPUT_XO;
+		}
+		break;
+	default:
+		return;
+	}
+
+	si5351_write(SI5351_PLL_INPUT_SOURCE, reg_val);
+
+	set_pll(plla_freq, SI5351_PLLA);
+	set_pll(pllb_freq, SI5351_PLLB);
+}
+
+/*
+ * set_vcxo(uint64_t pll_freq, uint8_t ppm)
+ *
+ * pll_freq - Desired PLL base frequency in Hz * 100
+ * ppm - VCXO pull limit in ppm
+ *
+ * Set the parameters for the VCXO on the Si5351B.
+ */
+void Si5351::set_vcxo(uint64_t pll_freq, uint8_t ppm)
+{
+	SI5351_API_SCOPE(SI5351_API_SET_VCXO);
+
+	struct Si5351RegSet pll_reg;
+	uint64_t vcxo_param;
+
+	// Bounds check
+	if(ppm < SI5351_VCXO_PULL_MIN)
+	{
+		ppm = SI5351_VCXO_PULL_MIN;
+	}
+
+	if(ppm > SI5351_VCXO_PULL_MAX)
+	{
+		ppm = SI5351_VCXO_PULL_MAX;
+	}
+
+	// Set PLLB params
+	vcxo_param = pll_calc(SI5351_PLLB, pll_freq, &pll_reg, ref_correction[pllb_ref_osc], 1);
+
+	// Derive the register values to write
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	uint8_t temp;
+	pack_params(&pll_reg, params);
+
+	// Write the parameters
+	si5351_write_bulk(SI5351_PLLB_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
+
+	// Write the VCXO parameters
+	vcxo_param = ((vcxo_param * ppm * SI5351_VCXO_MARGIN) / 100ULL) / 1000000ULL;
+
+	temp = (uint8_t)(vcxo_param & 0xFF);
+	si5351_write(SI5351_VXCO_PARAMETERS_LOW, temp);
+
+	temp = (uint8_t)((vcxo_param >> 8) & 0xFF);
+	si5351_write(SI5351_VXCO_PARAMETERS_MID, temp);
+
+	temp = (uint8_t)((vcxo_param >> 16) & 0x3F);
+	si5351_write(SI5351_VXCO_PARAMETERS_HIGH, temp);
+}
+
+/*
+ * set_ref_freq(uint32_t ref_freq, enum si5351_pll_input ref_osc)
+ *
+ * ref_freq - Reference oscillator frequency in Hz
+ * ref_osc - Which reference oscillator frequency to set
+ *    (use the si5351_pll_input enum)
+ *
+ * Set the reference frequency value for the desired reference oscillator
+ */
+void Si5351::set_ref_freq(uint32_t ref_freq, enum si5351_pll_input ref_osc)
+{
+	// uint8_t reg_val;
+	//reg_val = reg_cache[SI5351_PLL_INPUT_SOURCE];
+
+	// Clear the bits first
+	//reg_val &= ~(SI5351_CLKIN_DIV_MASK);
+
+	if(ref_freq <= 30000000UL)
+	{
+		xtal_freq[(uint8_t)ref_osc] = ref_freq;
+		//reg_val |= SI5351_CLKIN_DIV_1;
+		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
+		{
+			clkin_div = SI5351_CLKIN_DIV_1;
+		}
+	}
+	else if(ref_freq > 30000000UL && ref_freq <= 60000000UL)
+	{
+		xtal_freq[(uint8_t)ref_osc] = ref_freq / 2;
+		//reg_val |= SI5351_CLKIN_DIV_2;
+		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
+		{
+			clkin_div = SI5351_CLKIN_DIV_2;
+		}
+	}
+	else if(ref_freq > 60000000UL && ref_freq <= 100000000UL)
+	{
+		xtal_freq[(uint8_t)ref_osc] = ref_freq / 4;
+		//reg_val |= SI5351_CLKIN_DIV_4;
+		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
+		{
+			clkin_div = SI5351_CLKIN_DIV_4;
+		}
+	}
+	else
+	{
+		//reg_val |= SI5351_CLKIN_DIV_1;
+	}
+
+	update_ref_freq_corr(ref_osc);
+
+	//si5351_write(SI5351_PLL_INPUT_SOURCE, reg_val);
+}
+
+/*
+ * Register ranges held in a snapshot: interrupt mask and output enable,
+ * OEB pin enable, PLL input through the CLK6/7 R dividers, spread
+ * spectrum, VCXO and phase offsets, crystal load, and fanout enable.
+ */
+static const uint8_t snapshot_ranges[][2] = {{2, 2}, {9, 1}, {15, 78},
+	{149, 22}, {183, 1}, {187, 1}};
+
+/*
+ * save_snapshot(struct Si5351Snapshot *snap)
+ *
+ * Capture the configuration of the Si5351 and of this object, so that
+ * it can be put back later with restore_snapshot(). Registers held in
+ * the register shadow are taken from there; any others are read from
+ * the device.
+ *
+ * snap - Pointer to the struct that receives the snapshot
+ */
+void Si5351::save_snapshot(struct Si5351Snapshot *snap)
+{
+	SI5351_API_SCOPE(SI5351_API_SAVE_SNAPSHOT);
+
+	uint8_t i, j, reg, n = 0;
+
+	for(i = 0; i < sizeof(snapshot_ranges) / sizeof(snapshot_ranges[0]); i++)
+	{
+		// Read the whole range if any of it is missing from the shadow
+		for(j = 0; j < snapshot_ranges[i][1]; j++)
+		{
+			reg = snapshot_ranges[i][0] + j;
+			if(!(reg_valid[reg >> 3] & (1 << (reg & 7))))
+			{
+				si5351_read_bulk(snapshot_ranges[i][0], snapshot_ranges[i][1], &snap->regs[n]);
+				break;
+			}
+		}
+
+		for(j = 0; j < snapshot_ranges[i][1]; j++)
+		{
+			reg = snapshot_ranges[i][0] + j;
+			if(reg_valid[reg >> 3] & (1 << (reg & 7)))
+			{
+				snap->regs[n] = reg_cache[reg];
+			}
+			n++;
+		}
+	}
+
+	snap->pll_assignment = 0;
+	for(i = 0; i < 8; i++)
+	{
+		snap->clk_freq[i] = clk_freq[i];
+		if(pll_assignment[i] == SI5351_PLLB)
+		{
+			snap->pll_assignment |= (1 << i);
+		}
+	}
+	snap->plla_freq = plla_freq;
+	snap->pllb_freq = pllb_freq;
+	snap->ref_correction[0] = ref_correction[0];
+	snap->ref_correction[1] = ref_correction[1];
+}
+
+/*
+ * restore_snapshot(const struct Si5351Snapshot *snap)
+ *
+ * Put back a configuration captured with save_snapshot(), following the
+ * order given in the datasheet: the outputs are disabled and powered
+ * down, the registers are written in as few bursts as possible, both
+ * PLLs are reset, and then the outputs are enabled again. This also
+ * works right after init() to bring up a stored profile.
+ *
+ * This must not be called inside a transaction. In asynchronous mode
+ * the writes still go out before this returns.
+ *
+ * snap - Snapshot to restore
+ *
+ * Returns 0 on success, 1 if called inside a transaction, or the last
+ * non-zero endTransmission() status.
+ */
+uint8_t Si5351::restore_snapshot(const struct Si5351Snapshot *snap)
+{
+	SI5351_API_SCOPE(SI5351_API_RESTORE_SNAPSHOT);
+
+	uint8_t regs[SI5351_SNAPSHOT_LENGTH];
+	uint8_t buf[8];
+	uint8_t i, n = 0;
+	uint8_t saved_async = async_mode;
+	uint8_t ret_val = 0;
+	uint8_t status;
+
+	if(txn_depth != 0)
+	{
+		return 1;
+	}
+	async_mode = 0;
+	memcpy(regs, snap->regs, sizeof(regs));
+
+	// Disable all outputs, then power down the output drivers
+	buf[0] = regs[0];
+	buf[1] = 0xFF;
+	status = si5351_write_bulk(SI5351_INTERRUPT_MASK, 2, buf);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+	memset(buf, SI5351_CLK_POWERDOWN, 8);
+	status = si5351_write_bulk(SI5351_CLK0_CTRL, 8, buf);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+
+	// Everything else goes out in register order, with the PLL reset last
+	begin_transaction();
+	for(i = 0; i < sizeof(snapshot_ranges) / sizeof(snapshot_ranges[0]); i++)
+	{
+		if(snapshot_ranges[i][0] == SI5351_INTERRUPT_MASK)
+		{
+			// Already written, and output enable waits until the end
+			n += snapshot_ranges[i][1];
+			continue;
+		}
+		si5351_write_bulk(snapshot_ranges[i][0], snapshot_ranges[i][1], &regs[n]);
+		n += snapshot_ranges[i][1];
+	}
+	si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_A | SI5351_PLL_RESET_B);
+	status = commit();
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+
+	status = si5351_write(SI5351_OUTPUT_ENABLE_CTRL, regs[1]);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+	async_mode = saved_async;
+
+	// Object state
+	for(i = 0; i < 8; i++)
+	{
+		clk_freq[i] = snap->clk_freq[i];
+		clk_first_set[i] = true;
+		pll_assignment[i] = (snap->pll_assignment & (1 << i)) ? SI5351_PLLB : SI5351_PLLA;
+	}
+	plla_freq = snap->plla_freq;
+	pllb_freq = snap->pllb_freq;
+	ref_correction[0] = snap->ref_correction[0];
+	ref_correction[1] = snap->ref_correction[1];
+	sync_ref_osc();
+
+	// Dividers picked by PLL tuning mode or set_freq_phased() no longer apply
+	pll_tune_div[0] = 0;
+	pll_tune_div[1] = 0;
+	phased_div = 0;
+	phased_mask = 0;
+
+	return ret_val;
+}
+
+/*
+ * load_regs(const struct Si5351RegValue *table, uint16_t count)
+ *
+ * Write a register table stored in flash (PROGMEM), such as one made by
+ * the cbgen tool in the extras folder from a ClockBuilder export. The
+ * outputs are disabled and powered down first, the table is written in
+ * contiguous bursts, both PLLs are reset, and then the output enable
+ * register from the table is written last. No frequency math is done,
+ * so the clk_freq member and the PLL frequencies are not updated.
+ *
+ * Call this after init(). It must not be called inside a transaction.
+ * In asynchronous mode the writes still go out before this returns.
+ *
+ * table - Array of register addresses and values in PROGMEM
+ * count - Number of entries in the table
+ *
+ * Returns 0 on success, 1 if called inside a transaction, or the last
+ * non-zero endTransmission() status.
+ */
+uint8_t Si5351::load_regs(const struct Si5351RegValue *table, uint16_t count)
+{
+	SI5351_API_SCOPE(SI5351_API_LOAD_REGS);
+
+	uint8_t ctrl[8];
+	uint8_t buf[8];
+	uint8_t out_en, addr, value;
+	uint8_t saved_async = async_mode;
+	uint8_t ret_val = 0;
+	uint8_t status;
+	uint16_t i;
+
+	if(txn_depth != 0)
+	{
+		return 1;
+	}
+	async_mode = 0;
+
+	// Keep the current output setup for anything the table leaves out
+	out_en = reg_cache[SI5351_OUTPUT_ENABLE_CTRL];
+	memcpy(ctrl, &reg_cache[SI5351_CLK0_CTRL], 8);
+
+	// Disable all outputs, then power down the output drivers
+	status = si5351_write(SI5351_OUTPUT_ENABLE_CTRL, 0xFF);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+	memset(buf, SI5351_CLK_POWERDOWN, 8);
+	status = si5351_write_bulk(SI5351_CLK0_CTRL, 8, buf);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+
+	// Staging the table merges neighbouring registers into bursts
+	begin_transaction();
+	si5351_write_bulk(SI5351_CLK0_CTRL, 8, ctrl);
+	for(i = 0; i < count; i++)
+	{
+		if(pgm_read_word(&table[i].addr) >= SI5351_REG_COUNT)
+		{
+			continue;
+		}
+		addr = pgm_read_word(&table[i].addr);
+		value = pgm_read_byte(&table[i].value);
+
+		if(addr == SI5351_OUTPUT_ENABLE_CTRL)
+		{
+			out_en = value;
+		}
+		else if(addr != SI5351_DEVICE_STATUS && addr != SI5351_INTERRUPT_STATUS)
+		{
+			si5351_write(addr, value);
+		}
+	}
+	si5351_write(SI5351_PLL_RESET, SI5351_PLL_RESET_A | SI5351_PLL_RESET_B);
+	status = commit();
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+
+	status = si5351_write(SI5351_OUTPUT_ENABLE_CTRL, out_en);
+	if(status != 0)
+	{
+		ret_val = status;
+	}
+	async_mode = saved_async;
+
+	sync_ref_osc();
+	pll_tune_div[0] = 0;
+	pll_tune_div[1] = 0;
+	phased_div = 0;
+	phased_mask = 0;
+
+	return ret_val;
+}
+
+/*
+ * load_plan(const struct Si5351ConstPlan *plan)
+ *
+ * Set an output from a plan worked out by the compiler with
+ * Si5351::plan(), for example:
+ *
+ *   constexpr struct Si5351ConstPlan clk0_plan =
+ *     Si5351::plan<25000000, 1000000000ULL, SI5351_CLK0>();
+ *   si5351.load_plan(&clk0_plan);
+ *
+ * The result is the same as calling set_freq() right after init(), but
+ * no frequency math is done here. The PLL registers are only written if
+ * they differ from what is already there, in which case the PLL is reset.
+ * Other outputs on the same PLL are not recalculated.
+ *
+ * plan - Plan made by Si5351::plan()
+ *
+ * Returns 0 on success, or the last non-zero endTransmission() status.
+ */
+uint8_t Si5351::load_plan(const struct Si5351ConstPlan *plan)
+{
+	SI5351_API_SCOPE(SI5351_API_LOAD_PLAN);
+
+	struct Si5351RegSet pll_reg = plan->pll_reg;
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	uint8_t base;
+	enum si5351_clock clk = (enum si5351_clock)plan->clk;
+	enum si5351_pll pll = (enum si5351_pll)plan->pll;
+	uint8_t pll_reset_needed = plan->pll_reset;
+
+	begin_transaction();
+
+	pack_params(&pll_reg, params);
+	base = (pll == SI5351_PLLA) ? SI5351_PLLA_PARAMETERS : SI5351_PLLB_PARAMETERS;
+	if(memcmp(params, &reg_cache[base], SI5351_PARAMETERS_LENGTH) != 0)
+	{
+		si5351_write_bulk(base, SI5351_PARAMETERS_LENGTH, params);
+		pll_reset_needed = 1;
+	}
+	if(pll == SI5351_PLLA)
+	{
+		plla_freq = plan->pll_freq;
+	}
+	else
+	{
+		pllb_freq = plan->pll_freq;
+	}
+
+	if(pll_assignment[clk] != pll)
+	{
+		set_ms_source(clk, pll);
+	}
+
+	// Enable the output on first set only, as set_freq() does for CLK0-5
+	if(clk <= SI5351_CLK5 && clk_first_set[(uint8_t)clk] == false)
+	{
+		output_enable(clk, 1);
+		clk_first_set[(uint8_t)clk] = true;
+	}
+	clk_freq[(uint8_t)clk] = plan->freq;
+
+	set_ms(clk, plan->ms_reg, plan->int_mode, plan->r_div, plan->div_by_4);
+
+	if(pll_reset_needed)
+	{
+		pll_reset(pll);
+	}
+
+	return commit();
+}
+
+/*
+ * readback(uint8_t *regs)
+ *
+ * Read the whole register map of the Si5351 (registers 0 to 187) in
+ * SI5351_READ_MAX byte bursts, and refresh the register shadow from it.
+ * Registers with writes still pending in a transaction keep their
+ * staged values in the shadow. Use this to check the device against the
+ * library's view of it, or to pick up changes made behind its back.
+ *
+ * regs - Array of SI5351_REG_COUNT bytes that receives the registers,
+ *   or NULL to only refresh the shadow
+ *
+ * Returns 0 on success, or the bus status of the burst that failed.
+ */
+uint8_t Si5351::readback(uint8_t *regs)
+{
+	SI5351_API_SCOPE(SI5351_API_READBACK);
+
+	uint8_t buf[SI5351_READ_MAX];
+	uint8_t status, len, reg;
+	uint8_t addr = 0;
+
+	while(addr < SI5351_REG_COUNT)
+	{
+		len = (SI5351_REG_COUNT - addr > SI5351_READ_MAX) ? SI5351_READ_MAX : SI5351_REG_COUNT - addr;
+		status = i2c_read_bulk(addr, len, buf);
+		if(status != 0)
+		{
+			return status;
+		}
+
+		for(uint8_t i = 0; i < len; i++)
+		{
+			reg = addr + i;
+			if(regs != NULL)
+			{
+				regs[reg] = buf[i];
+			}
+
+			// The status registers and the self-clearing PLL reset are not
+			// shadowed, and staged registers keep their pending values
+			if(reg < SI5351_INTERRUPT_MASK || reg == SI5351_PLL_RESET ||
+				(reg_dirty[reg >> 3] & (1 << (reg & 7))))
+			{
+				continue;
+			}
+			reg_cache[reg] = buf[i];
+			reg_valid[reg >> 3] |= (1 << (reg & 7));
+		}
+		addr += len;
+	}
+
+	return 0;
+}
+
+/*
+ * begin_transaction(void)
+ *
+ * Start staging register writes. Until the matching commit(), all
+ * register writes made by the library (or through si5351_write() and
+ * si5351_write_bulk()) only update the register shadow and mark the
+ * written registers as pending. Transactions may be nested; only the
+ * outermost commit() touches the bus.
+ */
+void Si5351::begin_transaction(void)
+{
+	txn_depth++;
+}
+
+/*
+ * commit(void)
+ *
+ * Close a transaction started with begin_transaction(). When the
+ * outermost transaction is committed, the staged registers are written
+ * to the Si5351 as the fewest possible contiguous bursts, in register
+ * order, with any PLL reset issued last.
+ *
+ * Returns 0 on success, or the last non-zero endTransmission() status.
+ */
+uint8_t Si5351::commit(void)
+{
+	SI5351_API_SCOPE(SI5351_API_COMMIT);
+
+	uint8_t ret_val = 0;
+	uint8_t status;
+
+	if(txn_depth == 0)
+	{
+		return 0;
+	}
+	if(--txn_depth > 0)
+	{
+		return 0;
+	}
+
+	// In asynchronous mode the staged registers are left for poll()
+	if(async_mode)
+	{
+		return 0;
+	}
+
+	while(next_staged_burst(NULL, NULL))
+	{
+		status = write_staged_burst();
+		if(status != 0)
+		{
+			ret_val = status;
+		}
+	}
+
+	// The PLL reset always goes out after the parameters it applies to
+	if(reg_dirty[SI5351_PLL_RESET >> 3] & (1 << (SI5351_PLL_RESET & 7)))
+	{
+		reg_dirty[SI5351_PLL_RESET >> 3] &= ~(1 << (SI5351_PLL_RESET & 7));
+		status = i2c_write_bulk(SI5351_PLL_RESET, 1, &reg_cache[SI5351_PLL_RESET]);
+		if(status != 0)
+		{
+			ret_val = status;
+		}
+	}
+
+	return ret_val;
+}
+
+/*
+ * commit_step(void)
+ *
+ * Write only the next staged burst of an open transaction, leaving the
+ * transaction open. This lets the staged writes of several Si5351s be
+ * interleaved on the bus (see Si5351Array). The PLL reset is never
+ * written here; it goes out with the final commit().
+ *
+ * Returns 0 on success, or the endTransmission() status.
+ */
+uint8_t Si5351::commit_step(void)
+{
+	SI5351_API_SCOPE(SI5351_API_COMMIT);
+
+	if(txn_depth == 0 || !next_staged_burst(NULL, NULL))
+	{
+		return 0;
+	}
+
+	return write_staged_burst();
+}
+
+/*
+ * staged_bursts(void)
+ *
+ * Returns the number of bursts that the staged registers of an open
+ * transaction will take on the bus, not counting the PLL reset.
+ */
+uint8_t Si5351::staged_bursts(void)
+{
+	uint8_t count = 0;
+	uint8_t len;
+	uint16_t reg = 0;
+
+	while(reg < SI5351_REG_COUNT)
+	{
+		if(reg == SI5351_PLL_RESET || !(reg_dirty[reg >> 3] & (1 << (reg & 7))))
+		{
+			reg++;
+			continue;
+		}
+
+		len = 0;
+		while(reg < SI5351_REG_COUNT && reg != SI5351_PLL_RESET &&
+			(reg_dirty[reg >> 3] & (1 << (reg & 7))))
+		{
+			reg++;
+			len++;
+		}
+		count += (len + SI5351_BURST_MAX - 1) / SI5351_BURST_MAX;
+	}
+
+	return count;
+}
+
+/*
+ * set_async(uint8_t enable)
+ *
+ * enable - 1 to queue register writes for poll(), 0 to write them
+ *   right away (the default)
+ *
+ * In asynchronous mode the setters only compute their register values
+ * and stage them in the register shadow, then return without touching
+ * the bus. Repeated writes to the same register are merged, so only the
+ * latest value goes out. Call poll() regularly (e.g. once per pass of
+ * the main loop) to drain the queue one burst at a time. Turning
+ * asynchronous mode off flushes anything still queued. Enable it after
+ * init().
+ */
+void Si5351::set_async(uint8_t enable)
+{
+	if(!enable && async_mode)
+	{
+		async_mode = 0;
+		flush();
+	}
+	async_mode = enable;
+}
+
+/*
+ * poll(void)
+ *
+ * Write at most one queued burst to the Si5351. Registers are sent in
+ * address order, and a queued PLL reset is only sent once all other
+ * queued registers have been written. Nothing is written while a
+ * transaction is open.
+ *
+ * Returns 0 on success, or the endTransmission() status.
+ */
+uint8_t Si5351::poll(void)
+{
+	SI5351_API_SCOPE(SI5351_API_POLL);
+
+	if(txn_depth != 0)
+	{
+		return 0;
+	}
+
+	if(next_staged_burst(NULL, NULL))
+	{
+		return write_staged_burst();
+	}
+
+	if(reg_dirty[SI5351_PLL_RESET >> 3] & (1 << (SI5351_PLL_RESET & 7)))
+	{
+		reg_dirty[SI5351_PLL_RESET >> 3] &= ~(1 << (SI5351_PLL_RESET & 7));
+		return i2c_write_bulk(SI5351_PLL_RESET, 1, &reg_cache[SI5351_PLL_RESET]);
+	}
+
+	return 0;
+}
+
+/*
+ * busy(void)
+ *
+ * Returns 1 if register writes are still queued for poll(), else 0.
+ */
+uint8_t Si5351::busy(void)
+{
+	for(uint8_t i = 0; i < sizeof(reg_dirty); i++)
+	{
+		if(reg_dirty[i])
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * flush(void)
+ *
+ * Call poll() until all queued register writes have been sent.
+ *
+ * Returns 0 on success, or the last non-zero endTransmission() status.
+ */
+uint8_t Si5351::flush(void)
+{
+	SI5351_API_SCOPE(SI5351_API_POLL);
+
+	uint8_t ret_val = 0;
+	uint8_t status;
+
+	if(txn_depth != 0)
+	{
+		return 0;
+	}
+
+	while(busy())
+	{
+		status = poll();
+		if(status != 0)
+		{
+			ret_val = status;
+		}
+	}
+
+	return ret_val;
+}
+
+/*
+ * set_delta_write(uint8_t enable)
+ *
+ * enable - Set to 1 to enable, 0 to disable
+ *
+ * In delta write mode, set_ms(), set_int() and the R divider setting only
+ * send the registers whose contents differ from what was last written.
+ * A small frequency step on a multisynth then usually costs one short
+ * burst covering registers 47-49 (for CLK0) instead of a full 8-byte
+ * parameter write plus two control register writes.
+ *
+ * Delta write mode relies on the register shadow matching the device,
+ * so do not use it if the Si5351 can be reset behind the library's back.
+ */
+void Si5351::set_delta_write(uint8_t enable)
+{
+	delta_write = enable;
+}
+
+/*
+ * set_verify(uint8_t enable)
+ *
+ * enable - Set to 1 to enable, 0 to disable
+ *
+ * In verify mode, every burst written to the Si5351 is read back with
+ * one bulk read and compared with what was sent. A mismatch makes the
+ * write return SI5351_VERIFY_ERROR (so commit() and the other methods
+ * that report a bus status return it too). The status registers and the
+ * self-clearing PLL reset register are not checked.
+ *
+ * This roughly doubles the bus traffic, so it is meant for bring-up and
+ * production testing rather than normal use.
+ */
+void Si5351::set_verify(uint8_t enable)
+{
+	verify_write = enable;
+}
+
+/*
+ * set_pll_tuning(enum si5351_pll target_pll, uint8_t enable)
+ *
+ * target_pll - Which PLL to put into tuning mode
+ *     (use the si5351_pll enum)
+ * enable - Set to 1 to enable, 0 to disable
+ *
+ * In PLL tuning mode, set_freq() on CLK0 through CLK5 keeps the
+ * Multisynth at a fixed even integer divider in integer mode and tunes
+ * the output by moving the PLL instead, which gives the lowest output
+ * jitter. As long as the new frequency can be reached with the same
+ * divider, a retune only writes the changed PLL feedback registers
+ * (usually 31-33 for PLLA or 39-41 for PLLB) and does not reset the PLL.
+ * The PLL feedback integer mode bit is also set whenever the PLL lands
+ * on an integer multiple of its reference.
+ *
+ * Since the PLL follows the output frequency, only one clock output
+ * should be assigned to a PLL in tuning mode. set_freq() on that output
+ * returns the bus status of the retune.
+ */
+void Si5351::set_pll_tuning(enum si5351_pll target_pll, uint8_t enable)
+{
+	uint8_t reg_val;
+
+	pll_tuning[(uint8_t)target_pll] = enable;
+	pll_tune_div[(uint8_t)target_pll] = 0;
+
+	if(enable == 0)
+	{
+		// Leave the PLL feedback in fractional mode
+		reg_val = reg_cache[SI5351_CLK6_CTRL + (uint8_t)target_pll];
+		reg_val &= ~(SI5351_CLK_INTEGER_MODE);
+		write_regs(SI5351_CLK6_CTRL + (uint8_t)target_pll, 1, &reg_val, 1);
+	}
+}
+
+/*
+ * set_frac_solver(enum si5351_frac_solver solver)
+ *
+ * solver - How the fractional part of the PLL and Multisynth dividers
+ *   is found (use the si5351_frac_solver enum)
+ *
+ * SI5351_FRAC_FIXED_DENOM (the default) uses a fixed denominator of
+ * 1000000. SI5351_FRAC_BEST_RATIONAL searches for the closest fraction
+ * with any denominator up to 1048575, which gives a more accurate output
+ * frequency at the cost of some extra computation time.
+ */
+void Si5351::set_frac_solver(enum si5351_frac_solver solver)
+{
+	frac_solver = solver;
+}
+
+/*
+ * set_bus_speed(uint32_t speed)
+ *
+ * speed - I2C bus clock in Hz, such as 100000, 400000 (Fast-mode)
+ *   or 1000000 (Fast-mode Plus)
+ *
+ * Set the clock of the I2C bus the Si5351 is on. It is applied right
+ * away and again every time init() starts the bus. A value of 0 leaves
+ * the bus at the speed its driver starts with.
+ */
+void Si5351::set_bus_speed(uint32_t speed)
+{
+	bus_speed = speed;
+	if(bus_speed != 0)
+	{
+		bus->set_clock(bus_speed);
+	}
+}
+
+/*
+ * set_init_timeout(uint16_t timeout)
+ *
+ * timeout - Longest time in ms that init() waits for the Si5351 to
+ *   finish its own startup, or 0 to wait forever
+ *
+ * After power is applied, the Si5351 holds SYS_INIT until it has loaded
+ * its configuration, which normally takes a few ms. init() polls the
+ * flag, starting every SI5351_INIT_POLL_MIN us and backing off up to
+ * every SI5351_INIT_POLL_MAX us, and returns false if the device is not
+ * ready within the timeout (SI5351_INIT_TIMEOUT ms unless set here).
+ * Call this before init().
+ */
+void Si5351::set_init_timeout(uint16_t timeout)
+{
+	init_timeout = timeout;
+}
+
+/*
+ * get_init_time(void)
+ *
+ * Returns the time in us that the last call to init() or init_fixed()
+ * took, from the start of the bus to the end of the reset. Use this to
+ * measure how soon after power-up the outputs can be programmed.
+ */
+uint32_t Si5351::get_init_time(void)
+{
+	return init_time;
+}
+
+#ifdef SI5351_BUS_STATS
+/*
+ * get_bus_stats(enum si5351_api api, struct Si5351BusStats *stats)
+ *
+ * api - Public method to report on (use the si5351_api enum), or
+ *   SI5351_API_COUNT for the totals over all of them
+ * stats - Pointer to the struct that receives a snapshot of the counters
+ *
+ * Only available when the library is built with SI5351_BUS_STATS.
+ * The I2C traffic of a call is charged to the outermost public method
+ * it was made from, along with the time spent in the bus transfers in
+ * microseconds.
+ */
+void Si5351::get_bus_stats(enum si5351_api api, struct Si5351BusStats *stats)
+{
+	if(api < SI5351_API_COUNT)
+	{
+		*stats = bus_stats[api];
+		return;
+	}
+
+	memset(stats, 0, sizeof(struct Si5351BusStats));
+	for(uint8_t i = 0; i < SI5351_API_COUNT; i++)
+	{
+		stats->calls += bus_stats[i].calls;
+		stats->transactions += bus_stats[i].transactions;
+		stats->bytes_written += bus_stats[i].bytes_written;
+		stats->bytes_read += bus_stats[i].bytes_read;
+		stats->errors += bus_stats[i].errors;
+		stats->time_us += bus_stats[i].time_us;
+	}
+}
+
+/*
+ * reset_bus_stats(void)
+ *
+ * Clear all of the bus traffic counters.
+ */
+void Si5351::reset_bus_stats(void)
+{
+	memset(bus_stats, 0, sizeof(bus_stats));
+}
+#endif
+
+#ifdef SI5351_MATH_STATS
+/*
+ * get_math_stats(struct Si5351MathStats *stats)
+ *
+ * stats - Pointer to the struct that receives a snapshot of the counters
+ *
+ * Only available when the library is built with SI5351_MATH_STATS.
+ * div64 counts the generic 64-bit divisions and modulos done by the
+ * frequency math, each of which runs 64 shift-and-subtract steps on an
+ * 8-bit target. div_steps counts the steps of the shorter divisions
+ * done by udiv_bounded().
+ */
+void Si5351::get_math_stats(struct Si5351MathStats *stats)
+{
+	*stats = math_stats;
+}
+
+/*
+ * reset_math_stats(void)
+ *
+ * Clear the division counters.
+ */
+void Si5351::reset_math_stats(void)
+{
+	memset(&math_stats, 0, sizeof(math_stats));
+}
+#endif
+
+uint8_t Si5351::si5351_write_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
+{
+	SI5351_API_SCOPE(SI5351_API_RAW);
+
+	if(txn_depth == 0 && !async_mode)
+	{
+		for(int i = 0; i < bytes; i++)
+		{
+			uint8_t reg = addr + i;
+
+			if(reg < SI5351_REG_COUNT)
+			{
+				reg_cache[reg] = data[i];
+				reg_valid[reg >> 3] |= (1 << (reg & 7));
+			}
+		}
+
+		return i2c_write_bulk(addr, bytes, data);
+	}
+
+	// Stage the changed registers until commit(), or until poll()
+	// drains them in asynchronous mode
+	for(int i = 0; i < bytes; i++)
+	{
+		uint8_t reg = addr + i;
+
+		if(reg >= SI5351_REG_COUNT)
+		{
+			break;
+		}
+
+		if(reg == SI5351_PLL_RESET)
+		{
+			// Resets accumulate so that both PLLs can be reset in one write
+			if(reg_dirty[reg >> 3] & (1 << (reg & 7)))
+			{
+				reg_cache[reg] |= data[i];
+			}
+			else
+			{
+				reg_cache[reg] = data[i];
+			}
+			reg_dirty[reg >> 3] |= (1 << (reg & 7));
+		}
+		else
+		{
+			reg_cache[reg] = data[i];
+			reg_dirty[reg >> 3] |= (1 << (reg & 7));
+		}
+		reg_valid[reg >> 3] |= (1 << (reg & 7));
+	}
+
+	return 0;
+}
+
+uint8_t Si5351::si5351_write(uint8_t addr, uint8_t data)
+{
+	return si5351_write_bulk(addr, 1, &data);
+}
+
+uint8_t Si5351::si5351_read(uint8_t addr)
+{
+	SI5351_API_SCOPE(SI5351_API_RAW);
+	uint8_t reg_val = 0;
+
+	i2c_read_bulk(addr, 1, &reg_val);
+
+	return reg_val;
+}
+
+uint8_t Si5351::si5351_read_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
+{
+	SI5351_API_SCOPE(SI5351_API_RAW);
+
+	return i2c_read_bulk(addr, bytes, data);
+}
+
+/*********************/
+/* Private functions */
+/*********************/
+
+uint8_t Si5351::set_freq_pll_tuned(uint64_t freq, enum si5351_clock clk)
+{
+	struct Si5351RegSet pll_reg, ms_reg;
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	enum si5351_pll target_pll = pll_assignment[clk];
+	uint64_t pll_freq, ms_freq;
+	uint32_t div;
+	uint8_t r_div, new_div;
+
+	// Enable the output on first set_freq only
+	if(clk_first_set[(uint8_t)clk] == false)
+	{
+		output_enable(clk, 1);
+		clk_first_set[(uint8_t)clk] = true;
+	}
+
+	clk_freq[(uint8_t)clk] = freq;
+
+	ms_freq = freq;
+	r_div = select_r_div(&ms_freq);
+
+	// Keep the present divider if the PLL can still reach the frequency
+	div = pll_tune_div[(uint8_t)target_pll];
+	pll_freq = ms_freq * div;
+	new_div = (div == 0 || pll_tune_clk[(uint8_t)target_pll] != clk ||
+		pll_tune_rdiv[(uint8_t)target_pll] != r_div ||
+		pll_freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT ||
+		pll_freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT);
+
+	if(new_div)
+	{
+		// Pick the even divider that puts the PLL nearest mid-range,
+		// for the widest tuning range before the divider must change
+		if(ms_freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
+		{
+			div = 4;
+		}
+		else
+		{
+			div = (uint32_t)(((SI5351_PLL_VCO_MIN + SI5351_PLL_VCO_MAX) / 2 * SI5351_FREQ_MULT
+				+ ms_freq) / (ms_freq * 2)) * 2;
+			if(div < SI5351_MULTISYNTH_A_MIN)
+			{
+				div = SI5351_MULTISYNTH_A_MIN;
+			}
+			if(div > SI5351_MULTISYNTH_A_MAX)
+			{
+				div = SI5351_MULTISYNTH_A_MAX;
+			}
+		}
+		pll_freq = ms_freq * div;
+
+		pll_tune_div[(uint8_t)target_pll] = div;
+		pll_tune_rdiv[(uint8_t)target_pll] = r_div;
+		pll_tune_clk[(uint8_t)target_pll] = clk;
+	}
+
+	begin_transaction();
+
+	// Set the PLL; on a plain retune only the changed bytes are sent
+	pll_calc(target_pll, pll_freq, &pll_reg,
+		ref_correction[target_pll == SI5351_PLLA ? plla_ref_osc : pllb_ref_osc], 0);
+	pack_params(&pll_reg, params);
+	if(target_pll == SI5351_PLLA)
+	{
+		write_regs(SI5351_PLLA_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, !new_div || delta_write);
+		plla_freq = pll_freq;
+	}
+	else
+	{
+		write_regs(SI5351_PLLB_PARAMETERS, SI5351_PARAMETERS_LENGTH, params, !new_div || delta_write);
+		pllb_freq = pll_freq;
+	}
+
+	// The feedback divider is an integer when P2 and the fractional part
+	// of P1 are both zero
+	set_fb_int(target_pll, (pll_reg.p2 == 0 && (pll_reg.p1 & 0x7F) == 0) ? 1 : 0);
+
+	if(new_div)
+	{
+		// Even integer Multisynth divider, DIVBY4 above 150 MHz
+		ms_reg.p1 = (div == 4) ? 0 : 128 * div - 512;
+		ms_reg.p2 = 0;
+		ms_reg.p3 = 1;
+		set_ms(clk, ms_reg, 1, r_div, (div == 4) ? 1 : 0);
+
+		pll_reset(target_pll);
+	}
+
+	// All of the writes above are staged, so this has their bus status
+	return commit();
+}
+
+/*
+ * best_rational(uint64_t num, uint64_t den, uint32_t max_den, uint32_t *b, uint32_t *c)
+ *
+ * Find the fraction b/c closest to num/den (where num < den) with c no
+ * larger than max_den, by walking the continued fraction expansion of
+ * num/den and checking the last semiconvergent. A result of b == c means
+ * that num/den rounds up to 1.
+ */
+void Si5351::best_rational(uint64_t num, uint64_t den, uint32_t max_den, uint32_t *b, uint32_t *c)
+{
+	uint64_t p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+	uint64_t n = num, d = den;
+	uint64_t a, t, k;
+
+	while(d != 0)
+	{
+		SI5351_COUNT_DIV64(q1 != 0 ? 2 : 1);
+		a = n / d;
+
+		// Stop once the next convergent's denominator is too large
+		if(q1 != 0 && a > (max_den - q0) / q1)
+		{
+			break;
+		}
+
+		t = p0 + a * p1;
+		p0 = p1;
+		p1 = t;
+		t = q0 + a * q1;
+		q0 = q1;
+		q1 = t;
+
+		t = n - a * d;
+		n = d;
+		d = t;
+	}
+
+	if(d != 0)
+	{
+		// The semiconvergent is the closer one when k > a/2
+		SI5351_COUNT_DIV64(1);
+		k = (max_den - q0) / q1;
+		if(2 * k > a)
+		{
+			p1 = p0 + k * p1;
+			q1 = q0 + k * q1;
+		}
+	}
+
+	*b = (uint32_t)p1;
+	*c = (uint32_t)q1;
+}
+
+/*
+ * reg_cache_seed(void)
+ *
+ * Load the register shadow from the device. Only the registers that
+ * are read-modify-written by the library need to be fetched here, since
+ * every other register is fully written before the shadow is consulted.
+ * They are read as a few bulk reads of the ranges that hold them: the
+ * output enables, the input source, CLK and disable state controls, the
+ * Multisynth parameters with their R dividers, and the fanout enables.
+ */
+void Si5351::reg_cache_seed(void)
+{
+	static const uint8_t seed_ranges[][2] = {
+		{SI5351_OUTPUT_ENABLE_CTRL, 1},
+		{SI5351_PLL_INPUT_SOURCE, SI5351_CLK7_4_DISABLE_STATE - SI5351_PLL_INPUT_SOURCE + 1},
+		{SI5351_CLK0_PARAMETERS + 2, SI5351_CLK6_7_OUTPUT_DIVIDER - SI5351_CLK0_PARAMETERS - 1},
+		{SI5351_FANOUT_ENABLE, 1}};
+	uint8_t i, j, reg;
+
+	memset(reg_cache, 0, sizeof(reg_cache));
+	memset(reg_valid, 0, sizeof(reg_valid));
+
+	for(i = 0; i < sizeof(seed_ranges) / sizeof(seed_ranges[0]); i++)
+	{
+		si5351_read_bulk(seed_ranges[i][0], seed_ranges[i][1], &reg_cache[seed_ranges[i][0]]);
+		for(j = 0; j < seed_ranges[i][1]; j++)
+		{
+			reg = seed_ranges[i][0] + j;
+			reg_valid[reg >> 3] |= (1 << (reg & 7));
+		}
+	}
+}
+
+uint64_t Si5351::pll_calc(enum si5351_pll pll, uint64_t freq, struct Si5351RegSet *reg, int32_t correction, uint8_t vcxo)
+{
+	uint64_t ref_freq;
+	enum si5351_pll_input ref_osc = (pll == SI5351_PLLA) ? plla_ref_osc : pllb_ref_osc;
+	//ref_freq = 15974400ULL * SI5351_FREQ_MULT;
+	uint32_t a, b, c, p1, p2, p3;
+	uint64_t lltmp, rem; //, denom;
+
+	// Factor calibration value into nominal crystal frequency
+	// Measured in parts-per-billion. The corrected value is cached
+	// by set_correction() and set_ref_freq().
+	if(correction == ref_correction[(uint8_t)ref_osc])
+	{
+		ref_freq = ref_freq_corr[(uint8_t)ref_osc];
+	}
+	else
+	{
+		SI5351_COUNT_DIV64(1);
+		ref_freq = xtal_freq[(uint8_t)ref_osc] * SI5351_FREQ_MULT;
+		ref_freq = ref_freq + (int32_t)((((((int64_t)correction) << 31) / 1000000000LL) * ref_freq) >> 31);
+	}
+
+	// PLL bounds checking
+	if (freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT;
+	}
+	if (freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT;
+	}
+
+	// Determine integer part of feedback equation
+	a = udiv_bounded(freq, ref_freq, 7, &rem);
+
+	if (a < SI5351_PLL_A_MIN)
+	{
+		freq = ref_freq * SI5351_PLL_A_MIN;
+		rem = 0;
+	}
+	if (a > SI5351_PLL_A_MAX)
+	{
+		freq = ref_freq * SI5351_PLL_A_MAX;
+		rem = 0;
+	}
+
+	// Find best approximation for b/c = fVCO mod fIN
+	// denom = 1000ULL * 1000ULL;
+	// lltmp = freq % ref_freq;
+	// lltmp *= denom;
+	// do_div(lltmp, ref_freq);
+
+	//b = (((uint64_t)(freq % ref_freq)) * RFRAC_DENOM) / ref_freq;
+	if(vcxo)
+	{
+		b = udiv_bounded(rem * 1000000ULL, ref_freq, 20, NULL);
+		c = 1000000ULL;
+	}
+	else if(frac_solver == SI5351_FRAC_BEST_RATIONAL)
+	{
+		best_rational(rem, ref_freq, SI5351_PLL_C_MAX, &b, &c);
+		if(b == c)
+		{
+			// Rounded up to the next integer
+			a++;
+			b = 0;
+			c = 1;
+		}
+	}
+	else
+	{
+		b = udiv_bounded(rem * RFRAC_DENOM, ref_freq, 20, NULL);
+		c = b ? RFRAC_DENOM : 1;
+	}
+
+	// Calculate parameters
+  p1 = 128 * a + ((128 * b) / c) - 512;
+  p2 = 128 * b - c * ((128 * b) / c);
+  p3 = c;
+
+	// Recalculate frequency as fIN * (a + b/c)
+	lltmp = ref_freq;
+	lltmp *= b;
+	freq = udiv_bounded(lltmp, c, 32, NULL);
+	freq += ref_freq * a;
+
+	reg->p1 = p1;
+	reg->p2 = p2;
+	reg->p3 = p3;
+
+	if(vcxo)
+	{
+		return (uint64_t)(128 * a * 1000000ULL + b);
+	}
+	else
+	{
+		return freq;
+	}
+}
+
+uint64_t Si5351::multisynth_calc(uint64_t freq, uint64_t pll_freq, struct Si5351RegSet *reg)
+{
+	uint64_t lltmp;
+	uint32_t a, b, c, p1, p2, p3;
+	uint8_t divby4 = 0;
+	uint8_t ret_val = 0;
+
+	// Multisynth bounds checking
+	if (freq > SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT;
+	}
+	if (freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT;
+	}
+
+	if (freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
+	{
+		divby4 = 1;
+	}
+
+	if(pll_freq == 0)
+	{
+		// Find largest integer divider for max
+		// VCO frequency and given target frequency
+		if(divby4 == 0)
+		{
+			lltmp = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT; // margin needed?
+			lltmp = udiv_bounded(lltmp, freq, 11, NULL);
+			if(lltmp == 5)
+			{
+				lltmp = 4;
+			}
+			else if(lltmp == 7)
+			{
+				lltmp = 6;
+			}
+			a = (uint32_t)lltmp;
+		}
+		else
+		{
+			a = 4;
+		}
+
+		b = 0;
+		c = 1;
+		pll_freq = a * freq;
+	}
+	else
+	{
+		// Preset PLL, so return the actual freq for these params instead of PLL freq
+		ret_val = 1;
+
+		// Determine integer part of feedback equation
+		a = udiv_bounded(pll_freq, freq, 11, &lltmp);
+
+		if (a < SI5351_MULTISYNTH_A_MIN)
+		{
+			SI5351_COUNT_DIV64(2);
+			freq = pll_freq / SI5351_MULTISYNTH_A_MIN;
+			lltmp = pll_freq % freq;
+		}
+		if (a > SI5351_MULTISYNTH_A_MAX)
+		{
+			SI5351_COUNT_DIV64(2);
+			freq = pll_freq / SI5351_MULTISYNTH_A_MAX;
+			lltmp = pll_freq % freq;
+		}
+
+		if(frac_solver == SI5351_FRAC_BEST_RATIONAL)
+		{
+			best_rational(lltmp, freq, SI5351_MULTISYNTH_C_MAX, &b, &c);
+			if(b == c)
+			{
+				// Rounded up to the next integer
+				a++;
+				b = 0;
+				c = 1;
+			}
+		}
+		else
+		{
+			b = udiv_bounded(lltmp * RFRAC_DENOM, freq, 20, NULL);
+			c = b ? RFRAC_DENOM : 1;
+		}
+	}
+
+	// Calculate parameters
+	if (divby4 == 1)
+	{
+		p3 = 1;
+		p2 = 0;
+		p1 = 0;
+	}
+	else
+	{
+    p1 = 128 * a + ((128 * b) / c) - 512;
+    p2 = 128 * b - c * ((128 * b) / c);
+    p3 = c;
+	}
+
+	reg->p1 = p1;
+	reg->p2 = p2;
+	reg->p3 = p3;
+
+	if(ret_val == 0)
+	{
+		return pll_freq;
+	}
+	else
+	{
+		return freq;
+	}
+}
+
+uint64_t Si5351::multisynth67_calc(uint64_t freq, uint64_t pll_freq, struct Si5351RegSet *reg)
+{
+	//uint8_t p1;
+	// uint8_t ret_val = 0;
+	uint32_t a;
+	uint64_t lltmp;
+
+	// Multisynth bounds checking
+	if(freq > SI5351_MULTISYNTH67_MAX_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH67_MAX_FREQ * SI5351_FREQ_MULT;
+	}
+	if(freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT)
+	{
+		freq = SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT;
+	}
+
+	if(pll_freq == 0)
+	{
+		// Find largest integer divider for max
+		// VCO frequency and given target frequency
+		lltmp = (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) - 100000000UL; // margin needed?
+		a = udiv_bounded(lltmp, freq, 11, NULL);
+
+		// Divisor has to be even
+		if(a % 2 != 0)
+		{
+			a++;
+		}
+
+		// Divisor bounds check
+		if(a < SI5351_MULTISYNTH_A_MIN)
+		{
+			a = SI5351_MULTISYNTH_A_MIN;
+		}
+		if(a > SI5351_MULTISYNTH67_A_MAX)
+		{
+			a = SI5351_MULTISYNTH67_A_MAX;
+		}
+
+		pll_freq = a * freq;
+
+		// PLL bounds checking
+		if(pll_freq > (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT))
+		{
+			a -= 2;
+			pll_freq = a * freq;
+		}
+		else if(pll_freq < (SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT))
+		{
+			a += 2;
+			pll_freq = a * freq;
+		}
+
+		reg->p1 = (uint8_t)a;
+		reg->p2 = 0;
+		reg->p3 = 0;
+		return pll_freq;
+	}
+	else
+	{
+		// Multisynth frequency must be integer division of PLL
+		a = udiv_bounded(pll_freq, freq, 11, &lltmp);
+		if(lltmp)
+		{
+			// No good
+			return 0;
+		}
+		else
+		{
+
+			// Division ratio bounds check
+			if(a < SI5351_MULTISYNTH_A_MIN || a > SI5351_MULTISYNTH67_A_MAX)
+			{
+				// No bueno
+				return 0;
+			}
+			else
+			{
+				reg->p1 = (uint8_t)a;
+				reg->p2 = 0;
+				reg->p3 = 0;
+				return 1;
+			}
+		}
+	}
+}
+
+void Si5351::update_sys_status(uint8_t reg_val, struct Si5351Status *status)
+{
+  // Parse the register
+  status->SYS_INIT = (reg_val >> 7) & 0x01;
+  status->LOL_B = (reg_val >> 6) & 0x01;
+  status->LOL_A = (reg_val >> 5) & 0x01;
+  status->LOS = (reg_val >> 4) & 0x01;
+  status->REVID = reg_val & 0x03;
+}
+
+void Si5351::update_int_status(uint8_t reg_val, struct Si5351IntStatus *int_status)
+{
+  // Parse the register
+  int_status->SYS_INIT_STKY = (reg_val >> 7) & 0x01;
+  int_status->LOL_B_STKY = (reg_val >> 6) & 0x01;
+  int_status->LOL_A_STKY = (reg_val >> 5) & 0x01;
+  int_status->LOS_STKY = (reg_val >> 4) & 0x01;
+}
+
+void Si5351::ms_div(enum si5351_clock clk, uint8_t r_div, uint8_t div_by_4)
+{
+	uint8_t reg_val = 0;
+    uint8_t reg_addr = 0;
+
+	switch(clk)
+	{
+		case SI5351_CLK0:
+			reg_addr = SI5351_CLK0_PARAMETERS + 2;
+			break;
+		case SI5351_CLK1:
+			reg_addr = SI5351_CLK1_PARAMETERS + 2;
+			break;
+		case SI5351_CLK2:
+			reg_addr = SI5351_CLK2_PARAMETERS + 2;
+			break;
+		case SI5351_CLK3:
+			reg_addr = SI5351_CLK3_PARAMETERS + 2;
+			break;
+		case SI5351_CLK4:
+			reg_addr = SI5351_CLK4_PARAMETERS + 2;
+			break;
+		case SI5351_CLK5:
+			reg_addr = SI5351_CLK5_PARAMETERS + 2;
+			break;
+		case SI5351_CLK6:
+			reg_addr = SI5351_CLK6_7_OUTPUT_DIVIDER;
+			break;
+		case SI5351_CLK7:
+			reg_addr = SI5351_CLK6_7_OUTPUT_DIVIDER;
+			break;
+	}
 
-	// Register 28
-	temp = (uint8_t)((pll_reg.p1 >> 16) & 0x03);
-	params[i++] = temp;
+	reg_val = reg_cache[reg_addr];
+
+	if(clk <= (uint8_t)SI5351_CLK5)
+	{
+		// Clear the relevant bits
+		reg_val &= ~(0x7c);
 
-	// Registers 29-30
-	temp = (uint8_t)((pll_reg.p1 >> 8) & 0xFF);
-	params[i++] = temp;
+		if(div_by_4 == 0)
+		{
+			reg_val &= ~(SI5351_OUTPUT_CLK_DIVBY4);
+		}
+		else
+		{
+			reg_val |= (SI5351_OUTPUT_CLK_DIVBY4);
+		}
 
-	temp = (uint8_t)(pll_reg.p1  & 0xFF);
-	params[i++] = temp;
+		reg_val |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+	}
+	else if(clk == SI5351_CLK6)
+	{
+		// Clear the relevant bits
+		reg_val &= ~(0x07);
 
-	// Register 31
-	temp = (uint8_t)((pll_reg.p3 >> 12) & 0xF0);
-	temp += (uint8_t)((pll_reg.p2 >> 16) & 0x0F);
-	params[i++] = temp;
+		reg_val |= r_div;
+	}
+	else if(clk == SI5351_CLK7)
+	{
+		// Clear the relevant bits
+		reg_val &= ~(0x70);
 
-	// Registers 32-33
-	temp = (uint8_t)((pll_reg.p2 >> 8) & 0xFF);
-	params[i++] = temp;
+		reg_val |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+	}
 
-	temp = (uint8_t)(pll_reg.p2  & 0xFF);
-	params[i++] = temp;
+	write_regs(reg_addr, 1, &reg_val, delta_write);
+}
 
-	// Write the parameters
-	si5351_write_bulk(SI5351_PLLB_PARAMETERS, i, params);
+uint8_t Si5351::select_r_div(uint64_t *freq)
+{
+	uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+	uint32_t f;
 
-	delete params;
+	// Choose the correct R divider. The R_DIV codes are log2 of the
+	// ratio, so count the doublings needed to bring the frequency into
+	// the octave at or above 128 times the minimum output frequency.
+	// The whole range fits in 32 bits.
+	if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 128))
+	{
+		f = (uint32_t)*freq;
+		while(f < (uint32_t)(SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 128))
+		{
+			f <<= 1;
+			r_div++;
+		}
+		*freq = f;
+	}
 
-	// Write the VCXO parameters
-	vcxo_param = ((vcxo_param * ppm * SI5351_VCXO_MARGIN) / 100ULL) / 1000000ULL;
+	return r_div;
+}
 
-	temp = (uint8_t)(vcxo_param & 0xFF);
-	si5351_write(SI5351_VXCO_PARAMETERS_LOW, temp);
+uint8_t Si5351::select_r_div_ms67(uint64_t *freq)
+{
+	uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+	uint32_t f;
 
-	temp = (uint8_t)((vcxo_param >> 8) & 0xFF);
-	si5351_write(SI5351_VXCO_PARAMETERS_MID, temp);
+	// Choose the correct R divider, same as select_r_div()
+	if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 128))
+	{
+		f = (uint32_t)*freq;
+		while(f < (uint32_t)(SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 128))
+		{
+			f <<= 1;
+			r_div++;
+		}
+		*freq = f;
+	}
 
-	temp = (uint8_t)((vcxo_param >> 16) & 0x3F);
-	si5351_write(SI5351_VXCO_PARAMETERS_HIGH, temp);
+	return r_div;
 }
 
 /*
- * set_ref_freq(uint32_t ref_freq, enum si5351_pll_input ref_osc)
+ * udiv_bounded(uint64_t num, uint64_t den, uint8_t bits, uint64_t *rem)
  *
- * ref_freq - Reference oscillator frequency in Hz
- * ref_osc - Which reference oscillator frequency to set
- *    (use the si5351_pll_input enum)
+ * num - Dividend
+ * den - Divisor
+ * bits - Number of bits the quotient is known to fit in
+ * rem - Pointer to the remainder, may be NULL
  *
- * Set the reference frequency value for the desired reference oscillator
+ * Divide when the quotient is known to be small, as it is for every
+ * divider ratio in the chip. A shift-and-subtract loop over only the
+ * quotient bits is much cheaper than the generic 64-bit division on
+ * 8-bit targets, which always runs all 64 steps. Falls back to the
+ * generic division if the quotient does not fit.
  */
-void Si5351::set_ref_freq(uint32_t ref_freq, enum si5351_pll_input ref_osc)
+uint32_t Si5351::udiv_bounded(uint64_t num, uint64_t den, uint8_t bits, uint64_t *rem)
 {
-	// uint8_t reg_val;
-	//reg_val = si5351_read(SI5351_PLL_INPUT_SOURCE);
-
-	// Clear the bits first
-	//reg_val &= ~(SI5351_CLKIN_DIV_MASK);
+	uint32_t q = 0;
+	uint64_t d;
 
-	if(ref_freq <= 30000000UL)
+	if((num >> bits) >= den)
 	{
-		xtal_freq[(uint8_t)ref_osc] = ref_freq;
-		//reg_val |= SI5351_CLKIN_DIV_1;
-		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
+		SI5351_COUNT_DIV64(1);
+		q = num / den;
+		if(rem != NULL)
 		{
-			clkin_div = SI5351_CLKIN_DIV_1;
+			*rem = num - q * den;
 		}
+		return q;
 	}
-	else if(ref_freq > 30000000UL && ref_freq <= 60000000UL)
+
+	SI5351_COUNT_DIV_STEPS(bits);
+	d = den << (bits - 1);
+	while(bits--)
 	{
-		xtal_freq[(uint8_t)ref_osc] = ref_freq / 2;
-		//reg_val |= SI5351_CLKIN_DIV_2;
-		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
+		q <<= 1;
+		if(num >= d)
 		{
-			clkin_div = SI5351_CLKIN_DIV_2;
+			num -= d;
+			q |= 1;
 		}
+		d >>= 1;
 	}
-	else if(ref_freq > 60000000UL && ref_freq <= 100000000UL)
+
+	if(rem != NULL)
 	{
-		xtal_freq[(uint8_t)ref_osc] = ref_freq / 4;
-		//reg_val |= SI5351_CLKIN_DIV_4;
-		if(ref_osc == SI5351_PLL_INPUT_CLKIN)
-		{
-			clkin_div = SI5351_CLKIN_DIV_4;
-		}
+		*rem = num;
 	}
-	else
+	return q;
+}
+
+/*
+ * udiv_small(uint64_t num, uint64_t den, uint64_t *rem)
+ *
+ * Like udiv_bounded(), but the loop runs over only as many quotient bits
+ * as the result actually has, so a quotient of 0 or 1 costs next to
+ * nothing. Used to correct a predicted value, where the quotient is
+ * usually tiny.
+ */
+uint32_t Si5351::udiv_small(uint64_t num, uint64_t den, uint64_t *rem)
+{
+	uint8_t bits = 0;
+
+	while(bits < 32 && (num >> bits) >= den)
 	{
-		//reg_val |= SI5351_CLKIN_DIV_1;
+		bits++;
+	}
+	if(bits == 0)
+	{
+		if(rem != NULL)
+		{
+			*rem = num;
+		}
+		return 0;
 	}
 
-	//si5351_write(SI5351_PLL_INPUT_SOURCE, reg_val);
+	return udiv_bounded(num, den, bits, rem);
 }
 
-uint8_t Si5351::si5351_write_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
+/*
+ * mul_div(uint64_t a, uint64_t b, uint64_t c)
+ *
+ * a * b / c, rounded down, for a below c, without the product ever
+ * having to fit in 64 bits. The quotient is built up over the bits of
+ * b with shifts and subtractions. c must be below 2^62.
+ */
+uint64_t Si5351::mul_div(uint64_t a, uint64_t b, uint64_t c)
 {
-	Wire.beginTransmission(i2c_bus_addr);
-	Wire.write(addr);
-	for(int i = 0; i < bytes; i++)
+	uint64_t q = 0, r = 0;
+	int8_t bit = 63;
+
+	while(bit >= 0 && !(b >> bit))
+	{
+		bit--;
+	}
+	for(; bit >= 0; bit--)
 	{
-		Wire.write(data[i]);
+		q <<= 1;
+		r <<= 1;
+		if(r >= c)
+		{
+			r -= c;
+			q++;
+		}
+		if((b >> bit) & 1)
+		{
+			r += a;
+			if(r >= c)
+			{
+				r -= c;
+				q++;
+			}
+		}
 	}
-	return Wire.endTransmission();
 
+	return q;
 }
 
-uint8_t Si5351::si5351_write(uint8_t addr, uint8_t data)
+/*
+ * mul_q32(uint64_t a, uint64_t b)
+ *
+ * Product of two Q32 fixed-point numbers, rounded to Q32, without a
+ * 128-bit intermediate. The whole parts of a and b times each other
+ * must fit in 32 bits.
+ */
+uint64_t Si5351::mul_q32(uint64_t a, uint64_t b)
 {
-	Wire.beginTransmission(i2c_bus_addr);
-	Wire.write(addr);
-	Wire.write(data);
-	return Wire.endTransmission();
+	uint64_t a_hi = a >> 32, a_lo = a & 0xFFFFFFFFULL;
+	uint64_t b_hi = b >> 32, b_lo = b & 0xFFFFFFFFULL;
+
+	return ((a_hi * b_hi) << 32) + a_hi * b_lo + a_lo * b_hi +
+		((a_lo * b_lo + (1ULL << 31)) >> 32);
 }
 
-uint8_t Si5351::si5351_read(uint8_t addr)
+/*
+ * pow_q32(uint64_t x, uint16_t n, uint64_t limit)
+ *
+ * x to the power n, with x at least 1 and the result in Q32, by square
+ * and multiply. limit must be below 2^15 in Q32. Since no factor is
+ * less than 1, the work stops as soon as a partial result is over limit,
+ * and that partial result is returned instead.
+ */
+uint64_t Si5351::pow_q32(uint64_t x, uint16_t n, uint64_t limit)
 {
-	uint8_t reg_val = 0;
+	uint64_t result = 1ULL << 32;
 
-	Wire.beginTransmission(i2c_bus_addr);
-	Wire.write(addr);
-	Wire.endTransmission();
-
-	Wire.requestFrom(i2c_bus_addr, (uint8_t)1, (uint8_t)false);
-
-	while(Wire.available())
+	while(n != 0)
 	{
-		reg_val = Wire.read();
+		if(n & 1)
+		{
+			result = mul_q32(result, x);
+			if(result > limit)
+			{
+				return result;
+			}
+		}
+		n >>= 1;
+		if(n != 0)
+		{
+			x = mul_q32(x, x);
+			if(x > limit)
+			{
+				return x;
+			}
+		}
 	}
 
-	return reg_val;
+	return result;
 }
 
-/*********************/
-/* Private functions */
-/*********************/
+/*
+ * sweep_solve(struct Si5351Sweep *sweep, uint64_t freq)
+ *
+ * Work out the sweep state for an output frequency from scratch, with
+ * the same math as multisynth_calc(). The divider is kept as
+ * a + b / RFRAC_DENOM, along with the remainder of
+ * pll_freq * RFRAC_DENOM / (freq << r_div) for sweep_advance().
+ */
+void Si5351::sweep_solve(struct Si5351Sweep *sweep, uint64_t freq)
+{
+	uint64_t rem;
 
-uint64_t Si5351::pll_calc(enum si5351_pll pll, uint64_t freq, struct Si5351RegSet *reg, int32_t correction, uint8_t vcxo)
+	sweep->r_div = select_r_div(&freq);
+	sweep->fr = freq;
+	sweep->a = udiv_bounded(sweep->pll_freq, freq, 11, &rem);
+	sweep->b = udiv_bounded(rem * RFRAC_DENOM, freq, 20, &sweep->rem);
+	sweep->hist = 0;
+}
+
+/*
+ * sweep_advance(struct Si5351Sweep *sweep, uint64_t freq)
+ *
+ * Carry the sweep state forward to a new output frequency without a
+ * 64-bit division. With n = a * RFRAC_DENOM + b and the remainder
+ * rem = pll_freq * RFRAC_DENOM - n * fr kept from the last step, the
+ * change in n is predicted from the last two steps, the remainder is
+ * updated with multiplications, and the prediction is then corrected
+ * until the remainder is back in [0, fr). The correction is usually 0 or
+ * a few counts, and udiv_small() makes that cheap.
+ *
+ * Returns 0 if the R divider has to change, or the frequency moves by
+ * more than a factor of two, in which case sweep_solve() is needed.
+ */
+uint8_t Si5351::sweep_advance(struct Si5351Sweep *sweep, uint64_t freq)
 {
-	uint64_t ref_freq;
-	if(pll == SI5351_PLLA)
-	{
-		ref_freq = xtal_freq[(uint8_t)plla_ref_osc] * SI5351_FREQ_MULT;
-	}
-	else
+	const uint64_t octave = SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 128;
+	uint64_t fr = freq << sweep->r_div;
+	uint64_t q_rem;
+	uint32_t n, e;
+	int64_t dfr, pred, delta, rem, b;
+
+	if(fr < octave || (sweep->r_div != 0 && fr >= 2 * octave) ||
+		fr > 2 * sweep->fr || 2 * fr < sweep->fr)
 	{
-		ref_freq = xtal_freq[(uint8_t)pllb_ref_osc] * SI5351_FREQ_MULT;
+		return 0;
 	}
-	//ref_freq = 15974400ULL * SI5351_FREQ_MULT;
-	uint32_t a, b, c, p1, p2, p3;
-	uint64_t lltmp; //, denom;
-
-	// Factor calibration value into nominal crystal frequency
-	// Measured in parts-per-billion
 
-	ref_freq = ref_freq + (int32_t)((((((int64_t)correction) << 31) / 1000000000LL) * ref_freq) >> 31);
+	n = sweep->a * RFRAC_DENOM + sweep->b;
+	dfr = (int64_t)fr - (int64_t)sweep->fr;
 
-	// PLL bounds checking
-	if (freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT)
+	// Second-order prediction, kept within the range the true change
+	// can have so that the products below cannot overflow
+	if(sweep->hist == 0)
 	{
-		freq = SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT;
+		pred = 0;
 	}
-	if (freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT)
+	else if(sweep->hist == 1)
 	{
-		freq = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT;
+		pred = sweep->delta[0];
 	}
-
-	// Determine integer part of feedback equation
-	a = freq / ref_freq;
-
-	if (a < SI5351_PLL_A_MIN)
+	else
 	{
-		freq = ref_freq * SI5351_PLL_A_MIN;
+		pred = 2 * (int64_t)sweep->delta[0] - sweep->delta[1];
 	}
-	if (a > SI5351_PLL_A_MAX)
+	if(pred > (int64_t)n)
 	{
-		freq = ref_freq * SI5351_PLL_A_MAX;
+		pred = n;
+	}
+	if(pred < -(int64_t)n)
+	{
+		pred = -(int64_t)n;
 	}
 
-	// Find best approximation for b/c = fVCO mod fIN
-	// denom = 1000ULL * 1000ULL;
-	// lltmp = freq % ref_freq;
-	// lltmp *= denom;
-	// do_div(lltmp, ref_freq);
-
-	//b = (((uint64_t)(freq % ref_freq)) * RFRAC_DENOM) / ref_freq;
-	if(vcxo)
+	rem = (int64_t)sweep->rem - (int64_t)n * dfr - pred * (int64_t)fr;
+	delta = pred;
+	if(rem < 0)
 	{
-		b = (((uint64_t)(freq % ref_freq)) * 1000000ULL) / ref_freq;
-		c = 1000000ULL;
+		e = udiv_small(-rem - 1, fr, NULL) + 1;
+		delta -= e;
+		rem += (int64_t)e * (int64_t)fr;
 	}
-	else
+	else if(rem >= (int64_t)fr)
 	{
-		b = (((uint64_t)(freq % ref_freq)) * RFRAC_DENOM) / ref_freq;
-		c = b ? RFRAC_DENOM : 1;
+		e = udiv_small(rem, fr, &q_rem);
+		delta += e;
+		rem = q_rem;
 	}
 
-	// Calculate parameters
-  p1 = 128 * a + ((128 * b) / c) - 512;
-  p2 = 128 * b - c * ((128 * b) / c);
-  p3 = c;
-
-	// Recalculate frequency as fIN * (a + b/c)
-	lltmp = ref_freq;
-	lltmp *= b;
-	do_div(lltmp, c);
-	freq = lltmp;
-	freq += ref_freq * a;
-
-	reg->p1 = p1;
-	reg->p2 = p2;
-	reg->p3 = p3;
+	sweep->rem = rem;
+	sweep->fr = fr;
+	sweep->delta[1] = sweep->delta[0];
+	sweep->delta[0] = (int32_t)delta;
+	if(sweep->hist < 2)
+	{
+		sweep->hist++;
+	}
 
-	if(vcxo)
+	// Carry the change of n into the integer part of the divider
+	b = (int64_t)sweep->b + delta;
+	if(b < 0)
 	{
-		return (uint64_t)(128 * a * 1000000ULL + b);
+		e = udiv_small(-b - 1, RFRAC_DENOM, NULL) + 1;
+		sweep->a -= e;
+		b += (int64_t)e * RFRAC_DENOM;
 	}
-	else
+	else if(b >= (int64_t)RFRAC_DENOM)
 	{
-		return freq;
+		e = udiv_small(b, RFRAC_DENOM, &q_rem);
+		sweep->a += e;
+		b = q_rem;
 	}
+	sweep->b = (uint32_t)b;
+
+	return 1;
 }
 
-uint64_t Si5351::multisynth_calc(uint64_t freq, uint64_t pll_freq, struct Si5351RegSet *reg)
+/*
+ * sync_ref_osc(void)
+ *
+ * Take the PLL reference selection and CLKIN divider from the shadow of
+ * register 15 after it has been written wholesale, and refresh the
+ * corrected reference frequencies.
+ */
+void Si5351::sync_ref_osc(void)
 {
-	uint64_t lltmp;
-	uint32_t a, b, c, p1, p2, p3;
-	uint8_t divby4 = 0;
-	uint8_t ret_val = 0;
+	uint8_t reg_val = reg_cache[SI5351_PLL_INPUT_SOURCE];
 
-	// Multisynth bounds checking
-	if (freq > SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT)
-	{
-		freq = SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT;
-	}
-	if (freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT)
+	clkin_div = reg_val & SI5351_CLKIN_DIV_MASK;
+	plla_ref_osc = (reg_val & SI5351_PLLA_SOURCE) ? SI5351_PLL_INPUT_CLKIN : SI5351_PLL_INPUT_XO;
+	pllb_ref_osc = (reg_val & SI5351_PLLB_SOURCE) ? SI5351_PLL_INPUT_CLKIN : SI5351_PLL_INPUT_XO;
+	update_ref_freq_corr(SI5351_PLL_INPUT_XO);
+	update_ref_freq_corr(SI5351_PLL_INPUT_CLKIN);
+}
+
+/*
+ * init_device(uint8_t xtal_load_c)
+ *
+ * xtal_load_c - Crystal load capacitance
+ *
+ * Start the bus, check for the device and wait for it to finish its
+ * own startup, load the register shadow, and set the crystal load.
+ * Returns true if the device was found and became ready in time.
+ */
+bool Si5351::init_device(uint8_t xtal_load_c)
+{
+	// Start I2C comms
+	bus->begin();
+	if(bus_speed != 0)
 	{
-		freq = SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT;
+		bus->set_clock(bus_speed);
 	}
 
-	if (freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT)
+	// Check for a device on the bus, bail out if it is not there
+	uint8_t reg_val;
+#ifdef SI5351_BUS_STATS
+	uint32_t t0 = micros();
+#endif
+  reg_val = bus->probe(i2c_bus_addr);
+#ifdef SI5351_BUS_STATS
+	bus_stats_add(1, 0, 0, reg_val, micros() - t0);
+#endif
+
+	if(reg_val != 0)
 	{
-		divby4 = 1;
+		return false;
 	}
 
-	if(pll_freq == 0)
+	// Wait for SYS_INIT flag to be clear, indicating that device is ready.
+	// The poll interval doubles each time, so a slow start does not flood
+	// the bus, and a device stuck in startup gives up after init_timeout.
+	uint8_t status_reg = 0;
+	uint16_t poll_us = SI5351_INIT_POLL_MIN;
+	uint32_t wait_start = micros();
+	while(i2c_read_bulk(SI5351_DEVICE_STATUS, 1, &status_reg) != 0 ||
+		(status_reg & SI5351_STATUS_SYS_INIT))
 	{
-		// Find largest integer divider for max
-		// VCO frequency and given target frequency
-		if(divby4 == 0)
+		if(init_timeout != 0 && micros() - wait_start >= (uint32_t)init_timeout * 1000)
 		{
-			lltmp = SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT; // margin needed?
-			do_div(lltmp, freq);
-			if(lltmp == 5)
-			{
-				lltmp = 4;
-			}
-			else if(lltmp == 7)
-			{
-				lltmp = 6;
-			}
-			a = (uint32_t)lltmp;
+			return false;
 		}
-		else
+		delayMicroseconds(poll_us);
+		if(poll_us < SI5351_INIT_POLL_MAX)
 		{
-			a = 4;
+			poll_us <<= 1;
 		}
-
-		b = 0;
-		c = 1;
-		pll_freq = a * freq;
 	}
-	else
-	{
-		// Preset PLL, so return the actual freq for these params instead of PLL freq
-		ret_val = 1;
 
-		// Determine integer part of feedback equation
-		a = pll_freq / freq;
+	// Load the register shadow for the read-modify-write paths
+	reg_cache_seed();
 
-		if (a < SI5351_MULTISYNTH_A_MIN)
-		{
-			freq = pll_freq / SI5351_MULTISYNTH_A_MIN;
-		}
-		if (a > SI5351_MULTISYNTH_A_MAX)
-		{
-			freq = pll_freq / SI5351_MULTISYNTH_A_MAX;
-		}
+	// Set crystal load capacitance
+	si5351_write(SI5351_CRYSTAL_LOAD, (xtal_load_c & SI5351_CRYSTAL_LOAD_MASK) | 0b00010010);
 
-		b = (pll_freq % freq * RFRAC_DENOM) / freq;
-		c = b ? RFRAC_DENOM : 1;
-	}
+	return true;
+}
 
-	// Calculate parameters
-	if (divby4 == 1)
+/*
+ * update_ref_freq_corr(enum si5351_pll_input ref_osc)
+ *
+ * ref_osc - Reference oscillator to update
+ *
+ * Cache the reference frequency with the ppb correction applied,
+ * so that pll_calc() does not repeat the 64-bit math on every call.
+ */
+void Si5351::update_ref_freq_corr(enum si5351_pll_input ref_osc)
+{
+	uint64_t ref_freq = xtal_freq[(uint8_t)ref_osc] * SI5351_FREQ_MULT;
+
+	SI5351_COUNT_DIV64(1);
+	ref_freq = ref_freq + (int32_t)((((((int64_t)ref_correction[(uint8_t)ref_osc]) << 31) / 1000000000LL) * ref_freq) >> 31);
+	ref_freq_corr[(uint8_t)ref_osc] = (uint32_t)ref_freq;
+}
+
+/*
+ * pll_fine_freq(enum si5351_pll pll)
+ *
+ * pll - PLL to report on
+ *
+ * Returns the frequency that the PLL registers really give, in Hz *
+ * SI5351_FINE_FREQ_MULT, worked out from the corrected reference and the
+ * full a + b/c feedback divider. This can differ from the nominal
+ * plla_freq or pllb_freq by up to a step of the feedback divider.
+ */
+uint64_t Si5351::pll_fine_freq(enum si5351_pll pll)
+{
+	const uint8_t *params = &reg_cache[(pll == SI5351_PLLA) ? SI5351_PLLA_PARAMETERS : SI5351_PLLB_PARAMETERS];
+	uint64_t ref_freq = ref_freq_corr[(uint8_t)((pll == SI5351_PLLA) ? plla_ref_osc : pllb_ref_osc)];
+	uint64_t lltmp, rem;
+	uint32_t p1, p2, p3;
+
+	p1 = ((uint32_t)(params[2] & 0x03) << 16) | ((uint32_t)params[3] << 8) | params[4];
+	p2 = ((uint32_t)(params[5] & 0x0F) << 16) | ((uint32_t)params[6] << 8) | params[7];
+	p3 = ((uint32_t)(params[5] & 0xF0) << 12) | ((uint32_t)params[0] << 8) | params[1];
+	if(p3 == 0)
 	{
 		p3 = 1;
-		p2 = 0;
-		p1 = 0;
-	}
-	else
-	{
-    p1 = 128 * a + ((128 * b) / c) - 512;
-    p2 = 128 * b - c * ((128 * b) / c);
-    p3 = c;
 	}
 
-	reg->p1 = p1;
-	reg->p2 = p2;
-	reg->p3 = p3;
+	// fVCO = fREF * (p1 + 512 + p2 / p3) / 128. Keep the remainder of
+	// p2 / p3 apart so that nothing overflows.
+	lltmp = ref_freq * p2;
+	rem = lltmp % p3;
+	lltmp = (ref_freq * (p1 + 512) + lltmp / p3) * (SI5351_FINE_FREQ_MULT / SI5351_FREQ_MULT);
 
-	if(ret_val == 0)
+	return lltmp / 128 + ((lltmp % 128) * p3 + rem * (SI5351_FINE_FREQ_MULT / SI5351_FREQ_MULT)) / (128ULL * p3);
+}
+
+/*
+ * set_fb_int(enum si5351_pll target_pll, uint8_t enable)
+ *
+ * target_pll - PLL to update
+ * enable - 1 if the feedback divider is an integer, 0 if not
+ *
+ * Set or clear the FBA_INT or FBB_INT bit.
+ */
+void Si5351::set_fb_int(enum si5351_pll target_pll, uint8_t enable)
+{
+	uint8_t reg_val;
+
+	// FBA_INT and FBB_INT share the CLK6 and CLK7 control registers
+	reg_val = reg_cache[SI5351_CLK6_CTRL + (uint8_t)target_pll];
+	if(enable)
 	{
-		return pll_freq;
+		reg_val |= SI5351_CLK_INTEGER_MODE;
 	}
 	else
 	{
-		return freq;
+		reg_val &= ~(SI5351_CLK_INTEGER_MODE);
 	}
+	write_regs(SI5351_CLK6_CTRL + (uint8_t)target_pll, 1, &reg_val, 1);
 }
 
-uint64_t Si5351::multisynth67_calc(uint64_t freq, uint64_t pll_freq, struct Si5351RegSet *reg)
+uint8_t Si5351::calc_freq_step(enum si5351_clock clk, uint64_t freq, struct Si5351FreqStep *step)
 {
-	//uint8_t p1;
-	// uint8_t ret_val = 0;
-	uint32_t a;
-	uint64_t lltmp;
+	struct Si5351RegSet ms_reg;
+	uint64_t pll_freq;
+	uint8_t r_div;
 
-	// Multisynth bounds checking
-	if(freq > SI5351_MULTISYNTH67_MAX_FREQ * SI5351_FREQ_MULT)
+	if(pll_assignment[clk] == SI5351_PLLA)
 	{
-		freq = SI5351_MULTISYNTH67_MAX_FREQ * SI5351_FREQ_MULT;
+		pll_freq = plla_freq;
 	}
-	if(freq < SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT)
+	else
 	{
-		freq = SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT;
+		pll_freq = pllb_freq;
 	}
 
-	if(pll_freq == 0)
+	// Same bounds as set_freq() for outputs sharing a fixed PLL
+	if(freq > SI5351_MULTISYNTH_SHARE_MAX * SI5351_FREQ_MULT)
 	{
-		// Find largest integer divider for max
-		// VCO frequency and given target frequency
-		lltmp = (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) - 100000000UL; // margin needed?
-		do_div(lltmp, freq);
-		a = (uint32_t)lltmp;
-
-		// Divisor has to be even
-		if(a % 2 != 0)
-		{
-			a++;
-		}
-
-		// Divisor bounds check
-		if(a < SI5351_MULTISYNTH_A_MIN)
-		{
-			a = SI5351_MULTISYNTH_A_MIN;
-		}
-		if(a > SI5351_MULTISYNTH67_A_MAX)
-		{
-			a = SI5351_MULTISYNTH67_A_MAX;
-		}
-
-		pll_freq = a * freq;
-
-		// PLL bounds checking
-		if(pll_freq > (SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT))
-		{
-			a -= 2;
-			pll_freq = a * freq;
-		}
-		else if(pll_freq < (SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT))
-		{
-			a += 2;
-			pll_freq = a * freq;
-		}
-
-		reg->p1 = (uint8_t)a;
-		reg->p2 = 0;
-		reg->p3 = 0;
-		return pll_freq;
+		return 1;
 	}
-	else
+	if(freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT)
 	{
-		// Multisynth frequency must be integer division of PLL
-		if(pll_freq % freq)
-		{
-			// No good
-			return 0;
-		}
-		else
-		{
-			a = pll_freq / freq;
-
-			// Division ratio bounds check
-			if(a < SI5351_MULTISYNTH_A_MIN || a > SI5351_MULTISYNTH67_A_MAX)
-			{
-				// No bueno
-				return 0;
-			}
-			else
-			{
-				reg->p1 = (uint8_t)a;
-				reg->p2 = 0;
-				reg->p3 = 0;
-				return 1;
-			}
-		}
+		freq = SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT;
 	}
-}
 
-void Si5351::update_sys_status(struct Si5351Status *status)
-{
-  uint8_t reg_val = 0;
+	r_div = select_r_div(&freq);
+	multisynth_calc(freq, pll_freq, &ms_reg);
 
-  reg_val = si5351_read(SI5351_DEVICE_STATUS);
+	pack_params(&ms_reg, step->params);
+	step->params[2] |= reg_cache[(SI5351_CLK0_PARAMETERS + 2) + (clk * 8)] & ~(0x7F);
+	step->params[2] |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
 
-  // Parse the register
-  status->SYS_INIT = (reg_val >> 7) & 0x01;
-  status->LOL_B = (reg_val >> 6) & 0x01;
-  status->LOL_A = (reg_val >> 5) & 0x01;
-  status->LOS = (reg_val >> 4) & 0x01;
-  status->REVID = reg_val & 0x03;
+	return 0;
 }
 
-void Si5351::update_int_status(struct Si5351IntStatus *int_status)
+/*
+ * pack_params(struct Si5351RegSet *reg, uint8_t *params)
+ *
+ * Pack P1, P2 and P3 into the 8-byte register layout shared by the
+ * PLL feedback (26-41) and Multisynth 0-5 (42-89) parameter blocks.
+ * The upper bits of the third byte (R divider and DIVBY4 in the
+ * Multisynth blocks) are left clear for the caller to fill in.
+ */
+void Si5351::pack_params(struct Si5351RegSet *reg, uint8_t *params)
 {
-  uint8_t reg_val = 0;
+	// Registers 26-27 (PLLA), 42-43 (MS0)
+	params[0] = (uint8_t)((reg->p3 >> 8) & 0xFF);
+	params[1] = (uint8_t)(reg->p3 & 0xFF);
 
-  reg_val = si5351_read(SI5351_INTERRUPT_STATUS);
+	// Register 28 (PLLA), 44 (MS0)
+	params[2] = (uint8_t)((reg->p1 >> 16) & 0x03);
 
-  // Parse the register
-  int_status->SYS_INIT_STKY = (reg_val >> 7) & 0x01;
-  int_status->LOL_B_STKY = (reg_val >> 6) & 0x01;
-  int_status->LOL_A_STKY = (reg_val >> 5) & 0x01;
-  int_status->LOS_STKY = (reg_val >> 4) & 0x01;
+	// Registers 29-30 (PLLA), 45-46 (MS0)
+	params[3] = (uint8_t)((reg->p1 >> 8) & 0xFF);
+	params[4] = (uint8_t)(reg->p1 & 0xFF);
+
+	// Register 31 (PLLA), 47 (MS0)
+	params[5] = (uint8_t)((reg->p3 >> 12) & 0xF0);
+	params[5] += (uint8_t)((reg->p2 >> 16) & 0x0F);
+
+	// Registers 32-33 (PLLA), 48-49 (MS0)
+	params[6] = (uint8_t)((reg->p2 >> 8) & 0xFF);
+	params[7] = (uint8_t)(reg->p2 & 0xFF);
 }
 
-void Si5351::ms_div(enum si5351_clock clk, uint8_t r_div, uint8_t div_by_4)
+/*
+ * write_regs(uint8_t addr, uint8_t bytes, uint8_t *data, uint8_t delta)
+ *
+ * Write a block of registers. With delta set, only the span between the
+ * first and last register that differs from the shadow is written (or
+ * nothing at all if the block is unchanged).
+ */
+uint8_t Si5351::write_regs(uint8_t addr, uint8_t bytes, uint8_t *data, uint8_t delta)
 {
-	uint8_t reg_val = 0;
-    uint8_t reg_addr = 0;
+	uint8_t first, last, reg;
 
-	switch(clk)
+	if(delta == 0)
 	{
-		case SI5351_CLK0:
-			reg_addr = SI5351_CLK0_PARAMETERS + 2;
-			break;
-		case SI5351_CLK1:
-			reg_addr = SI5351_CLK1_PARAMETERS + 2;
-			break;
-		case SI5351_CLK2:
-			reg_addr = SI5351_CLK2_PARAMETERS + 2;
-			break;
-		case SI5351_CLK3:
-			reg_addr = SI5351_CLK3_PARAMETERS + 2;
-			break;
-		case SI5351_CLK4:
-			reg_addr = SI5351_CLK4_PARAMETERS + 2;
-			break;
-		case SI5351_CLK5:
-			reg_addr = SI5351_CLK5_PARAMETERS + 2;
-			break;
-		case SI5351_CLK6:
-			reg_addr = SI5351_CLK6_7_OUTPUT_DIVIDER;
-			break;
-		case SI5351_CLK7:
-			reg_addr = SI5351_CLK6_7_OUTPUT_DIVIDER;
-			break;
+		return si5351_write_bulk(addr, bytes, data);
 	}
 
-	reg_val = si5351_read(reg_addr);
-
-	if(clk <= (uint8_t)SI5351_CLK5)
+	first = bytes;
+	last = 0;
+	for(uint8_t i = 0; i < bytes; i++)
 	{
-		// Clear the relevant bits
-		reg_val &= ~(0x7c);
-
-		if(div_by_4 == 0)
-		{
-			reg_val &= ~(SI5351_OUTPUT_CLK_DIVBY4);
-		}
-		else
+		reg = addr + i;
+		if(!(reg_valid[reg >> 3] & (1 << (reg & 7))) || reg_cache[reg] != data[i])
 		{
-			reg_val |= (SI5351_OUTPUT_CLK_DIVBY4);
+			if(first == bytes)
+			{
+				first = i;
+			}
+			last = i;
 		}
-
-		reg_val |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
 	}
-	else if(clk == SI5351_CLK6)
-	{
-		// Clear the relevant bits
-		reg_val &= ~(0x07);
 
-		reg_val |= r_div;
-	}
-	else if(clk == SI5351_CLK7)
+	if(first == bytes)
 	{
-		// Clear the relevant bits
-		reg_val &= ~(0x70);
-
-		reg_val |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+		return 0;
 	}
 
-	si5351_write(reg_addr, reg_val);
+	return si5351_write_bulk(addr + first, last - first + 1, &data[first]);
 }
 
-uint8_t Si5351::select_r_div(uint64_t *freq)
+uint8_t Si5351::next_staged_burst(uint8_t *start, uint8_t *len)
 {
-	uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+	uint16_t reg = 0;
+	uint8_t n = 0;
 
-	// Choose the correct R divider
-	if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 2))
+	// Find the first staged register, skipping the PLL reset
+	while(reg < SI5351_REG_COUNT &&
+		(reg == SI5351_PLL_RESET || !(reg_dirty[reg >> 3] & (1 << (reg & 7)))))
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_128;
-		*freq *= 128ULL;
+		reg++;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 2) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 4))
+	if(reg >= SI5351_REG_COUNT)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_64;
-		*freq *= 64ULL;
+		return 0;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 4) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 8))
+
+	if(start != NULL)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_32;
-		*freq *= 32ULL;
+		*start = reg;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 8) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 16))
+
+	// The run ends at the first clean register, or when it fills a burst
+	while(reg < SI5351_REG_COUNT && reg != SI5351_PLL_RESET && n < SI5351_BURST_MAX &&
+		(reg_dirty[reg >> 3] & (1 << (reg & 7))))
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_16;
-		*freq *= 16ULL;
+		reg++;
+		n++;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 16) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 32))
+
+	if(len != NULL)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_8;
-		*freq *= 8ULL;
+		*len = n;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 32) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 64))
+	return 1;
+}
+
+uint8_t Si5351::write_staged_burst(void)
+{
+	uint8_t start, len;
+
+	if(!next_staged_burst(&start, &len))
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_4;
-		*freq *= 4ULL;
+		return 0;
 	}
-	else if((*freq >= SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 64) && (*freq < SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT * 128))
+
+	for(uint8_t i = start; i < start + len; i++)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_2;
-		*freq *= 2ULL;
+		reg_dirty[i >> 3] &= ~(1 << (i & 7));
 	}
 
-	return r_div;
+	return i2c_write_bulk(start, len, &reg_cache[start]);
 }
 
-uint8_t Si5351::select_r_div_ms67(uint64_t *freq)
+uint8_t Si5351::i2c_write_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
 {
-	uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+	uint8_t check[SI5351_READ_MAX];
+	uint8_t status, reg, len;
+#ifdef SI5351_BUS_STATS
+	uint32_t t0 = micros();
+#endif
+
+	status = bus->write(i2c_bus_addr, addr, data, bytes);
+#ifdef SI5351_BUS_STATS
+	bus_stats_add(1, bytes + 1, 0, status, micros() - t0);
+#endif
+
+	// A lone write to the PLL reset register has nothing to check
+	if(status != 0 || !verify_write || (addr == SI5351_PLL_RESET && bytes == 1))
+	{
+		return status;
+	}
 
-	// Choose the correct R divider
-	if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 2))
+	while(bytes > 0)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_128;
-		*freq *= 128ULL;
+		len = (bytes > SI5351_READ_MAX) ? SI5351_READ_MAX : bytes;
+		status = i2c_read_bulk(addr, len, check);
+		if(status != 0)
+		{
+			return status;
+		}
+
+		for(uint8_t i = 0; i < len; i++)
+		{
+			reg = addr + i;
+			if(reg != SI5351_DEVICE_STATUS && reg != SI5351_INTERRUPT_STATUS &&
+				reg != SI5351_PLL_RESET && check[i] != data[i])
+			{
+				return SI5351_VERIFY_ERROR;
+			}
+		}
+		addr += len;
+		data += len;
+		bytes -= len;
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 2) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 4))
+	return 0;
+}
+
+/*
+ * i2c_read_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
+ *
+ * Read a block of registers, split into bursts of at most SI5351_READ_MAX
+ * bytes (the size of the Wire receive buffer on AVR). Returns 0 on
+ * success, or the last non-zero bus status.
+ */
+uint8_t Si5351::i2c_read_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
+{
+	uint8_t ret_val = 0;
+	uint8_t status, len;
+#ifdef SI5351_BUS_STATS
+	uint32_t t0;
+#endif
+
+	while(bytes > 0)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_64;
-		*freq *= 64ULL;
+		len = (bytes > SI5351_READ_MAX) ? SI5351_READ_MAX : bytes;
+#ifdef SI5351_BUS_STATS
+		t0 = micros();
+#endif
+		status = bus->write_read(i2c_bus_addr, addr, data, len);
+#ifdef SI5351_BUS_STATS
+		bus_stats_add(2, 1, len, status, micros() - t0);
+#endif
+		if(status != 0)
+		{
+			ret_val = status;
+		}
+		addr += len;
+		data += len;
+		bytes -= len;
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 4) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 8))
+
+	return ret_val;
+}
+
+#ifdef SI5351_BUS_STATS
+/*
+ * ApiScope marks the public method that bus traffic is charged to.
+ * Only the outermost scope counts, so the PLL writes done inside
+ * set_freq() are charged to set_freq() and not to set_pll().
+ */
+Si5351::ApiScope::ApiScope(Si5351 *d, enum si5351_api api):
+	dev(d), prev(d->stats_api)
+{
+	if(prev == SI5351_API_RAW)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_32;
-		*freq *= 32ULL;
+		dev->stats_api = api;
+		dev->bus_stats[api].calls++;
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 8) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 16))
+}
+
+Si5351::ApiScope::~ApiScope()
+{
+	dev->stats_api = prev;
+}
+
+void Si5351::bus_stats_add(uint8_t txns, uint8_t written, uint8_t read, uint8_t status, uint32_t us)
+{
+	struct Si5351BusStats *stats = &bus_stats[stats_api];
+
+	stats->transactions += txns;
+	stats->bytes_written += written;
+	stats->bytes_read += read;
+	stats->time_us += us;
+	if(status != 0)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_16;
-		*freq *= 16ULL;
+		stats->errors++;
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 16) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 32))
+}
+#endif
+
+/*****************/
+/* Si5351WireBus */
+/*****************/
+
+Si5351WireBus::Si5351WireBus(TwoWire &wire_bus):
+	wire(&wire_bus)
+{
+}
+
+void Si5351WireBus::begin(void)
+{
+	wire->begin();
+}
+
+void Si5351WireBus::set_clock(uint32_t speed)
+{
+	wire->setClock(speed);
+}
+
+uint8_t Si5351WireBus::probe(uint8_t i2c_addr)
+{
+	wire->beginTransmission(i2c_addr);
+	return wire->endTransmission();
+}
+
+uint8_t Si5351WireBus::write(uint8_t i2c_addr, uint8_t addr, const uint8_t *data, uint8_t bytes)
+{
+	wire->beginTransmission(i2c_addr);
+	wire->write(addr);
+	for(int i = 0; i < bytes; i++)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_8;
-		*freq *= 8ULL;
+		wire->write(data[i]);
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 32) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 64))
+	return wire->endTransmission();
+}
+
+uint8_t Si5351WireBus::write_read(uint8_t i2c_addr, uint8_t addr, uint8_t *data, uint8_t bytes)
+{
+	uint8_t status;
+	uint8_t i = 0;
+
+	wire->beginTransmission(i2c_addr);
+	wire->write(addr);
+	status = wire->endTransmission();
+
+	if(wire->requestFrom(i2c_addr, bytes, (uint8_t)false) != bytes && status == 0)
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_4;
-		*freq *= 4ULL;
+		// Short read
+		status = 4;
 	}
-	else if((*freq >= SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 64) && (*freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT * 128))
+
+	while(wire->available())
 	{
-		r_div = SI5351_OUTPUT_CLK_DIV_2;
-		*freq *= 2ULL;
+		if(i < bytes)
+		{
+			data[i++] = wire->read();
+		}
+		else
+		{
+			wire->read();
+		}
 	}
 
-	return r_div;
+	return status;
 }
@@ -39,6 +39,7 @@
 #define SI5351_XTAL_FREQ                25000000
 #define SI5351_PLL_FIXED                80000000000ULL
 #define SI5351_FREQ_MULT                100ULL
+#define SI5351_FINE_FREQ_MULT           1000000ULL
 #define SI5351_DEFAULT_CLK              1000000000ULL
 
 #define SI5351_PLL_VCO_MIN              600000000
@@ -78,6 +79,9 @@
 #define SI5351_STATUS_LOL_B             (1<<6)
 #define SI5351_STATUS_LOL_A             (1<<5)
 #define SI5351_STATUS_LOS               (1<<4)
+#define SI5351_STATUS_LOS_XTAL          (1<<3)
+#define SI5351_EVENT_ALL                0xF8
+#define SI5351_EVENT_COUNT              5
 #define SI5351_OUTPUT_ENABLE_CTRL       3
 #define SI5351_OEB_PIN_ENABLE_CTRL      9
 #define SI5351_PLL_INPUT_SOURCE         15
@@ -187,6 +191,17 @@
 #define SI5351_XTAL_ENABLE              (1<<6)
 #define SI5351_MULTISYNTH_ENABLE        (1<<4)
 
+#define SI5351_REG_COUNT                188
+#define SI5351_PLAN_CANDIDATES          24
+#define SI5351_SNAPSHOT_LENGTH          105
+#define SI5351_BURST_MAX                31
+#define SI5351_READ_MAX                 32
+#define SI5351_VERIFY_ERROR             0x10
+#define SI5351_INIT_TIMEOUT             100
+#define SI5351_INIT_POLL_MIN            100
+#define SI5351_INIT_POLL_MAX            3200
+#define SI5351_PLL_LOCK_FAILED          0xFFFFFFFF
+
 
 /* Macro definitions */
 
@@ -250,6 +265,32 @@ enum si5351_clock_fanout {SI5351_FANOUT_CLKIN, SI5351_FANOUT_XO, SI5351_FANOUT_M
 
 enum si5351_pll_input {SI5351_PLL_INPUT_XO, SI5351_PLL_INPUT_CLKIN};
 
+enum si5351_frac_solver {SI5351_FRAC_FIXED_DENOM, SI5351_FRAC_BEST_RATIONAL};
+
+enum si5351_sweep_mode {SI5351_SWEEP_LINEAR, SI5351_SWEEP_LOG};
+
+/*
+ * Public entry points that bus traffic is charged to when the library
+ * is built with SI5351_BUS_STATS. SI5351_API_RAW covers direct calls to
+ * si5351_write(), si5351_write_bulk(), si5351_read() and si5351_read_bulk().
+ */
+enum si5351_api {SI5351_API_RAW, SI5351_API_INIT, SI5351_API_RESET,
+	SI5351_API_SET_FREQ, SI5351_API_SET_FREQ_MANUAL, SI5351_API_SET_FREQ_FINE,
+	SI5351_API_PLAY_FREQ_LIST, SI5351_API_SET_PLL, SI5351_API_SET_MS,
+	SI5351_API_OUTPUT_ENABLE, SI5351_API_DRIVE_STRENGTH, SI5351_API_UPDATE_STATUS,
+	SI5351_API_SET_CORRECTION, SI5351_API_SET_PHASE, SI5351_API_PLL_RESET,
+	SI5351_API_SET_MS_SOURCE, SI5351_API_SET_INT, SI5351_API_SET_CLOCK_PWR,
+	SI5351_API_SET_CLOCK_INVERT, SI5351_API_SET_CLOCK_SOURCE,
+	SI5351_API_SET_CLOCK_DISABLE, SI5351_API_SET_CLOCK_FANOUT,
+	SI5351_API_SET_PLL_INPUT, SI5351_API_SET_VCXO, SI5351_API_COMMIT,
+	SI5351_API_POLL, SI5351_API_APPLY_PLAN, SI5351_API_SET_FREQ_PHASED,
+	SI5351_API_RETUNE_PHASED, SI5351_API_SAVE_SNAPSHOT,
+	SI5351_API_RESTORE_SNAPSHOT, SI5351_API_LOAD_REGS, SI5351_API_INIT_FIXED,
+	SI5351_API_LOAD_PLAN, SI5351_API_READBACK,
+	SI5351_API_PLL_RESET_WAIT, SI5351_API_ENABLE_EVENTS,
+	SI5351_API_SERVICE_EVENTS, SI5351_API_SWEEP, SI5351_API_SYMBOLS,
+	SI5351_API_COUNT};
+
 /* Struct definitions */
 
 struct Si5351RegSet
@@ -259,6 +300,132 @@ struct Si5351RegSet
 	uint32_t p3;
 };
 
+struct Si5351FreqStep
+{
+	uint8_t params[SI5351_PARAMETERS_LENGTH];
+	uint8_t first;
+	uint8_t len;
+};
+
+struct Si5351Sweep
+{
+	enum si5351_clock clk;
+	enum si5351_sweep_mode mode;
+	uint16_t steps;
+	uint16_t index;
+	uint8_t down;
+	uint64_t freq;
+	uint64_t acc;
+	uint64_t stop;
+	uint64_t inc;
+	uint32_t inc_rem;
+	uint32_t err;
+	uint32_t ratio;
+	uint64_t pll_freq;
+	uint8_t r_div;
+	uint64_t fr;
+	uint64_t rem;
+	uint32_t a;
+	uint32_t b;
+	int32_t delta[2];
+	uint8_t hist;
+};
+
+struct Si5351Plan
+{
+	uint64_t pll_freq[2];
+	uint8_t pll_int[2];
+	uint64_t freq[8];
+	uint64_t achieved[8];
+	enum si5351_pll pll[8];
+	enum si5351_clock_source source[8];
+	uint8_t r_div[8];
+	uint16_t ms_div[8];
+	uint8_t failed;
+};
+
+struct Si5351ConstPlan
+{
+	uint64_t freq;
+	uint64_t pll_freq;
+	struct Si5351RegSet pll_reg;
+	struct Si5351RegSet ms_reg;
+	uint8_t clk;
+	uint8_t pll;
+	uint8_t int_mode;
+	uint8_t r_div;
+	uint8_t div_by_4;
+	uint8_t pll_reset;
+};
+
+struct Si5351RegValue
+{
+	uint16_t addr;
+	uint8_t value;
+};
+
+struct Si5351Snapshot
+{
+	uint8_t regs[SI5351_SNAPSHOT_LENGTH];
+	uint64_t clk_freq[8];
+	uint64_t plla_freq;
+	uint64_t pllb_freq;
+	int32_t ref_correction[2];
+	uint8_t pll_assignment;
+};
+
+struct Si5351SymbolStats
+{
+	uint16_t symbols;
+	uint32_t min_late_us;
+	uint32_t max_late_us;
+};
+
+struct Si5351Symbols
+{
+	enum si5351_clock clk;
+	const struct Si5351FreqStep *tones;
+	const uint8_t *data;
+	uint16_t count;
+	uint16_t index;
+	uint32_t edge;
+	uint32_t period_us;
+	uint16_t period_ns;
+	uint16_t ns_acc;
+	struct Si5351SymbolStats stats;
+};
+
+struct Si5351LockStats
+{
+	uint32_t locks;
+	uint32_t timeouts;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t mean_us;
+};
+
+struct Si5351FreqResult
+{
+	uint64_t achieved;
+	int64_t error;
+};
+
+struct Si5351BusStats
+{
+	uint32_t calls;
+	uint32_t transactions;
+	uint32_t bytes_written;
+	uint32_t bytes_read;
+	uint32_t errors;
+	uint32_t time_us;
+};
+
+struct Si5351MathStats
+{
+	uint32_t div64;
+	uint32_t div_steps;
+};
+
 struct Si5351Status
 {
 	uint8_t SYS_INIT;
@@ -276,23 +443,80 @@ struct Si5351IntStatus
 	uint8_t LOS_STKY;
 };
 
+/*
+ * Si5351Bus is the I2C transport used by the library. Derive from it to
+ * drive a Si5351 over something other than a TwoWire object, such as a
+ * bit-banged or DMA-driven bus. All methods return 0 on success or the
+ * endTransmission() style error code.
+ */
+class Si5351Bus
+{
+public:
+	virtual void begin(void) = 0;
+	virtual void set_clock(uint32_t) = 0;
+	virtual uint8_t probe(uint8_t) = 0;
+	virtual uint8_t write(uint8_t, uint8_t, const uint8_t *, uint8_t) = 0;
+	virtual uint8_t write_read(uint8_t, uint8_t, uint8_t *, uint8_t) = 0;
+};
+
+/*
+ * Si5351WireBus is the default transport, on the global Wire object
+ * unless another TwoWire instance (e.g. Wire1) is given.
+ */
+class Si5351WireBus : public Si5351Bus
+{
+public:
+	Si5351WireBus(TwoWire &wire_bus = Wire);
+	void begin(void);
+	void set_clock(uint32_t);
+	uint8_t probe(uint8_t);
+	uint8_t write(uint8_t, uint8_t, const uint8_t *, uint8_t);
+	uint8_t write_read(uint8_t, uint8_t, uint8_t *, uint8_t);
+private:
+	TwoWire *wire;
+};
+
 class Si5351
 {
 public:
-  Si5351(uint8_t i2c_addr = SI5351_BUS_BASE_ADDR);
+  Si5351(uint8_t i2c_addr = SI5351_BUS_BASE_ADDR, Si5351Bus *i2c_bus = NULL);
 	bool init(uint8_t, uint32_t, int32_t);
+	bool init_fixed(uint8_t);
 	void reset(void);
 	uint8_t set_freq(uint64_t, enum si5351_clock);
 	uint8_t set_freq_manual(uint64_t, uint64_t, enum si5351_clock);
+	uint8_t set_freq_fine(uint64_t, enum si5351_clock, struct Si5351FreqResult *);
+	uint8_t set_freq_phased(uint64_t, const enum si5351_clock *, const uint16_t *, uint8_t);
+	uint8_t retune_phased(uint64_t);
+	uint16_t compile_freq_list(enum si5351_clock, const uint64_t *, uint16_t, struct Si5351FreqStep *);
+	void play_freq_list(enum si5351_clock, const struct Si5351FreqStep *, uint16_t, void (*)(uint16_t));
+	uint8_t plan_outputs(const uint64_t *, const uint64_t *, struct Si5351Plan *);
+	uint8_t apply_plan(const struct Si5351Plan *);
+	uint8_t compile_tones(enum si5351_clock, uint64_t, uint64_t, uint8_t, struct Si5351FreqStep *);
+	void start_symbols(struct Si5351Symbols *, enum si5351_clock, const struct Si5351FreqStep *, const uint8_t *, uint16_t, uint32_t);
+	uint8_t symbol_tick(struct Si5351Symbols *);
+	void stop_symbols(struct Si5351Symbols *);
+	void get_symbol_stats(const struct Si5351Symbols *, struct Si5351SymbolStats *);
+	uint8_t start_sweep(struct Si5351Sweep *, enum si5351_clock, uint64_t, uint64_t, uint16_t, enum si5351_sweep_mode);
+	uint8_t sweep_step(struct Si5351Sweep *);
+	void stop_sweep(struct Si5351Sweep *);
 	void set_pll(uint64_t, enum si5351_pll);
 	void set_ms(enum si5351_clock, struct Si5351RegSet, uint8_t, uint8_t, uint8_t);
 	void output_enable(enum si5351_clock, uint8_t);
 	void drive_strength(enum si5351_clock, enum si5351_drive);
 	void update_status(void);
+	void enable_events(uint8_t);
+	void set_event_callback(uint8_t, void (*)(uint8_t));
+	void set_int_pin(uint8_t (*)(void));
+	void int_notify(void);
+	uint8_t service_events(void);
 	void set_correction(int32_t, enum si5351_pll_input);
 	void set_phase(enum si5351_clock, uint8_t);
 	int32_t get_correction(enum si5351_pll_input);
 	void pll_reset(enum si5351_pll);
+	uint32_t pll_reset_wait(enum si5351_pll, uint32_t);
+	void get_lock_stats(enum si5351_pll, struct Si5351LockStats *);
+	void reset_lock_stats(void);
 	void set_ms_source(enum si5351_clock, enum si5351_pll);
 	void set_int(enum si5351_clock, uint8_t);
 	void set_clock_pwr(enum si5351_clock, uint8_t);
@@ -303,9 +527,40 @@ public:
 	void set_pll_input(enum si5351_pll, enum si5351_pll_input);
 	void set_vcxo(uint64_t, uint8_t);
   void set_ref_freq(uint32_t, enum si5351_pll_input);
+	void save_snapshot(struct Si5351Snapshot *);
+	uint8_t restore_snapshot(const struct Si5351Snapshot *);
+	uint8_t load_regs(const struct Si5351RegValue *, uint16_t);
+	template<uint32_t XtalFreq, uint64_t Freq, enum si5351_clock Clk, int32_t Corr = 0>
+	static constexpr struct Si5351ConstPlan plan(void);
+	uint8_t load_plan(const struct Si5351ConstPlan *);
+	uint8_t readback(uint8_t *);
+	void begin_transaction(void);
+	uint8_t commit(void);
+	uint8_t commit_step(void);
+	uint8_t staged_bursts(void);
+	void set_async(uint8_t);
+	uint8_t poll(void);
+	uint8_t busy(void);
+	uint8_t flush(void);
+	void set_delta_write(uint8_t);
+	void set_verify(uint8_t);
+	void set_pll_tuning(enum si5351_pll, uint8_t);
+	void set_frac_solver(enum si5351_frac_solver);
+	void set_bus_speed(uint32_t);
+	void set_init_timeout(uint16_t);
+	uint32_t get_init_time(void);
+#ifdef SI5351_BUS_STATS
+	void get_bus_stats(enum si5351_api, struct Si5351BusStats *);
+	void reset_bus_stats(void);
+#endif
+#ifdef SI5351_MATH_STATS
+	void get_math_stats(struct Si5351MathStats *);
+	void reset_math_stats(void);
+#endif
 	uint8_t si5351_write_bulk(uint8_t, uint8_t, uint8_t *);
 	uint8_t si5351_write(uint8_t, uint8_t);
 	uint8_t si5351_read(uint8_t);
+	uint8_t si5351_read_bulk(uint8_t, uint8_t, uint8_t *);
 	struct Si5351Status dev_status = {.SYS_INIT = 0, .LOL_B = 0, .LOL_A = 0,
     .LOS = 0, .REVID = 0};
 	struct Si5351IntStatus dev_int_status = {.SYS_INIT_STKY = 0, .LOL_B_STKY = 0,
@@ -321,15 +576,273 @@ private:
 	uint64_t pll_calc(enum si5351_pll, uint64_t, struct Si5351RegSet *, int32_t, uint8_t);
 	uint64_t multisynth_calc(uint64_t, uint64_t, struct Si5351RegSet *);
 	uint64_t multisynth67_calc(uint64_t, uint64_t, struct Si5351RegSet *);
-	void update_sys_status(struct Si5351Status *);
-	void update_int_status(struct Si5351IntStatus *);
+	void update_sys_status(uint8_t, struct Si5351Status *);
+	void update_int_status(uint8_t, struct Si5351IntStatus *);
 	void ms_div(enum si5351_clock, uint8_t, uint8_t);
 	uint8_t select_r_div(uint64_t *);
 	uint8_t select_r_div_ms67(uint64_t *);
+	uint32_t udiv_bounded(uint64_t, uint64_t, uint8_t, uint64_t *);
+	uint32_t udiv_small(uint64_t, uint64_t, uint64_t *);
+	uint64_t mul_div(uint64_t, uint64_t, uint64_t);
+	uint64_t mul_q32(uint64_t, uint64_t);
+	uint64_t pow_q32(uint64_t, uint16_t, uint64_t);
+	void sweep_solve(struct Si5351Sweep *, uint64_t);
+	uint8_t sweep_advance(struct Si5351Sweep *, uint64_t);
+	bool init_device(uint8_t);
+	void update_ref_freq_corr(enum si5351_pll_input);
+	uint64_t pll_fine_freq(enum si5351_pll);
+	void sync_ref_osc(void);
+	void best_rational(uint64_t, uint64_t, uint32_t, uint32_t *, uint32_t *);
+	uint8_t set_freq_pll_tuned(uint64_t, enum si5351_clock);
+	uint8_t calc_freq_step(enum si5351_clock, uint64_t, struct Si5351FreqStep *);
+	void set_fb_int(enum si5351_pll, uint8_t);
+	void reg_cache_seed(void);
+	void pack_params(struct Si5351RegSet *, uint8_t *);
+	uint8_t write_regs(uint8_t, uint8_t, uint8_t *, uint8_t);
+	uint8_t next_staged_burst(uint8_t *, uint8_t *);
+	uint8_t write_staged_burst(void);
+	uint8_t i2c_write_bulk(uint8_t, uint8_t, uint8_t *);
+	uint8_t i2c_read_bulk(uint8_t, uint8_t, uint8_t *);
 	int32_t ref_correction[2];
+	uint32_t ref_freq_corr[2];
   uint8_t clkin_div;
   uint8_t i2c_bus_addr;
+	Si5351WireBus wire_bus;
+	Si5351Bus *bus;
+	uint32_t bus_speed;
+	uint16_t init_timeout;
+	uint32_t init_time;
   bool clk_first_set[8];
+	uint8_t reg_cache[SI5351_REG_COUNT];
+	uint8_t reg_dirty[(SI5351_REG_COUNT + 7) / 8];
+	uint8_t reg_valid[(SI5351_REG_COUNT + 7) / 8];
+	uint8_t txn_depth;
+	uint8_t async_mode;
+	uint8_t delta_write;
+	uint8_t verify_write;
+	enum si5351_frac_solver frac_solver;
+	uint8_t pll_tuning[2];
+	uint16_t pll_tune_div[2];
+	uint8_t pll_tune_rdiv[2];
+	enum si5351_clock pll_tune_clk[2];
+	enum si5351_pll phased_pll;
+	uint16_t phased_div;
+	uint8_t phased_mask;
+	struct Si5351LockStats lock_stats[2];
+	void (*event_callback[SI5351_EVENT_COUNT])(uint8_t);
+	uint8_t (*int_pin)(void);
+	volatile uint8_t event_pending;
+	uint32_t lock_total_us[2];
+#ifdef SI5351_BUS_STATS
+	class ApiScope
+	{
+	public:
+		ApiScope(Si5351 *, enum si5351_api);
+		~ApiScope();
+	private:
+		Si5351 *dev;
+		enum si5351_api prev;
+	};
+	friend class ApiScope;
+	void bus_stats_add(uint8_t, uint8_t, uint8_t, uint8_t, uint32_t);
+	struct Si5351BusStats bus_stats[SI5351_API_COUNT];
+	enum si5351_api stats_api;
+#endif
+#ifdef SI5351_MATH_STATS
+	struct Si5351MathStats math_stats;
+#endif
 };
 
+/*
+ * Compile-time versions of the frequency math used by set_freq(), for
+ * Si5351::plan(). Each one follows its run-time counterpart in
+ * si5351.cpp step for step (with the default SI5351_FRAC_FIXED_DENOM
+ * solver), so that a plan gives exactly the registers set_freq() would
+ * write right after init(). They are C++11 constexpr, hence written as
+ * single expressions.
+ */
+
+constexpr uint64_t si5351_ce_clamp(uint64_t f, uint64_t lo, uint64_t hi)
+{
+	return (f < lo) ? lo : ((f > hi) ? hi : f);
+}
+
+// set_ref_freq()
+constexpr uint64_t si5351_ce_xtal(uint32_t ref_freq)
+{
+	return (ref_freq == 0) ? SI5351_XTAL_FREQ :
+		((ref_freq <= 30000000UL) ? ref_freq :
+		((ref_freq <= 60000000UL) ? ref_freq / 2 :
+		((ref_freq <= 100000000UL) ? ref_freq / 4 : SI5351_XTAL_FREQ)));
+}
+
+// update_ref_freq_corr()
+constexpr uint32_t si5351_ce_ref(uint64_t xtal, int32_t corr)
+{
+	return (uint32_t)(xtal * SI5351_FREQ_MULT + (int32_t)(((uint64_t)((((int64_t)corr) * 2147483648LL) / 1000000000LL) *
+		(xtal * SI5351_FREQ_MULT)) >> 31));
+}
+
+constexpr struct Si5351RegSet si5351_ce_regset(uint32_t a, uint32_t b, uint32_t c)
+{
+	return {128 * a + ((128 * b) / c) - 512, 128 * b - c * ((128 * b) / c), c};
+}
+
+constexpr struct Si5351RegSet si5351_ce_frac(uint32_t a, uint32_t b)
+{
+	return si5351_ce_regset(a, b, b ? RFRAC_DENOM : 1);
+}
+
+// pll_calc()
+constexpr struct Si5351RegSet si5351_ce_pll_rem(uint32_t a, uint64_t rem, uint64_t ref)
+{
+	return si5351_ce_frac(a, (uint32_t)((rem * RFRAC_DENOM) / ref));
+}
+
+constexpr struct Si5351RegSet si5351_ce_pll_a(uint64_t freq, uint64_t ref)
+{
+	return si5351_ce_pll_rem((uint32_t)(freq / ref),
+		(freq / ref < SI5351_PLL_A_MIN || freq / ref > SI5351_PLL_A_MAX) ? 0 : freq % ref, ref);
+}
+
+constexpr struct Si5351RegSet si5351_ce_pll(uint64_t freq, uint64_t ref)
+{
+	return si5351_ce_pll_a(si5351_ce_clamp(freq, SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT,
+		SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT), ref);
+}
+
+// multisynth_calc() with a preset PLL frequency
+constexpr struct Si5351RegSet si5351_ce_ms_rem(uint32_t a, uint64_t rem, uint64_t freq, bool div_by_4)
+{
+	return div_by_4 ? Si5351RegSet{0, 0, 1} : si5351_ce_frac(a, (uint32_t)((rem * RFRAC_DENOM) / freq));
+}
+
+constexpr struct Si5351RegSet si5351_ce_ms_a(uint64_t pll_freq, uint64_t freq, uint32_t a, bool div_by_4)
+{
+	return (a < SI5351_MULTISYNTH_A_MIN) ?
+		si5351_ce_ms_rem(a, pll_freq % (pll_freq / SI5351_MULTISYNTH_A_MIN), pll_freq / SI5351_MULTISYNTH_A_MIN, div_by_4) :
+		((a > SI5351_MULTISYNTH_A_MAX) ?
+		si5351_ce_ms_rem(a, pll_freq % (pll_freq / SI5351_MULTISYNTH_A_MAX), pll_freq / SI5351_MULTISYNTH_A_MAX, div_by_4) :
+		si5351_ce_ms_rem(a, pll_freq % freq, freq, div_by_4));
+}
+
+constexpr struct Si5351RegSet si5351_ce_ms_clamped(uint64_t freq, uint64_t pll_freq)
+{
+	return si5351_ce_ms_a(pll_freq, freq, (uint32_t)(pll_freq / freq),
+		freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT);
+}
+
+constexpr struct Si5351RegSet si5351_ce_ms(uint64_t freq, uint64_t pll_freq)
+{
+	return si5351_ce_ms_clamped(si5351_ce_clamp(freq, SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT,
+		SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT), pll_freq);
+}
+
+// multisynth_calc() choosing the PLL frequency, for outputs over 100 MHz
+constexpr uint32_t si5351_ce_ms_div_fix(uint32_t a)
+{
+	return (a == 5) ? 4 : ((a == 7) ? 6 : a);
+}
+
+constexpr uint64_t si5351_ce_ms_pll(uint64_t freq)
+{
+	return ((freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT) ? 4 :
+		si5351_ce_ms_div_fix((uint32_t)((SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) / freq))) * freq;
+}
+
+// multisynth67_calc() choosing the PLL frequency, for a frequency
+// already within the Multisynth range
+constexpr uint32_t si5351_ce_ms67_bound(uint32_t a, uint64_t freq)
+{
+	return (a * freq > SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) ? a - 2 :
+		((a * freq < SI5351_PLL_VCO_MIN * SI5351_FREQ_MULT) ? a + 2 : a);
+}
+
+constexpr uint32_t si5351_ce_ms67_even(uint32_t a, uint64_t freq)
+{
+	return si5351_ce_ms67_bound((uint32_t)si5351_ce_clamp(a + (a % 2), SI5351_MULTISYNTH_A_MIN,
+		SI5351_MULTISYNTH67_A_MAX), freq);
+}
+
+constexpr uint32_t si5351_ce_ms67(uint64_t freq)
+{
+	return si5351_ce_ms67_even((uint32_t)(((SI5351_PLL_VCO_MAX * SI5351_FREQ_MULT) - 100000000UL) / freq), freq);
+}
+
+// select_r_div() and select_r_div_ms67()
+constexpr uint8_t si5351_ce_r_count(uint32_t f, uint32_t limit)
+{
+	return (f >= limit) ? 0 : 1 + si5351_ce_r_count(f << 1, limit);
+}
+
+constexpr uint8_t si5351_ce_r_div(uint64_t freq, uint64_t min_freq)
+{
+	return (freq >= min_freq && freq < min_freq * 128) ?
+		si5351_ce_r_count((uint32_t)freq, (uint32_t)(min_freq * 128)) : SI5351_OUTPUT_CLK_DIV_1;
+}
+
+// set_freq() on CLK0-5 up to 100 MHz, from PLLA at SI5351_PLL_FIXED
+constexpr struct Si5351ConstPlan si5351_ce_plan_low(uint32_t ref, uint64_t freq, uint8_t clk, uint8_t r_div)
+{
+	return {freq, SI5351_PLL_FIXED, si5351_ce_pll(SI5351_PLL_FIXED, ref),
+		si5351_ce_ms(freq << r_div, SI5351_PLL_FIXED), clk, SI5351_PLLA, 0, r_div, 0, 0};
+}
+
+// set_freq() on CLK0-5 over 100 MHz, which retunes PLLA
+constexpr struct Si5351ConstPlan si5351_ce_plan_high(uint32_t ref, uint64_t freq, uint8_t clk, uint64_t pll_freq)
+{
+	return {freq, pll_freq, si5351_ce_pll(pll_freq, ref), si5351_ce_ms(freq, pll_freq), clk, SI5351_PLLA,
+		freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT, SI5351_OUTPUT_CLK_DIV_1,
+		freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT, 1};
+}
+
+constexpr struct Si5351ConstPlan si5351_ce_plan_ms(uint32_t ref, uint64_t freq, uint8_t clk)
+{
+	return (freq > (SI5351_MULTISYNTH_SHARE_MAX * SI5351_FREQ_MULT)) ?
+		si5351_ce_plan_high(ref, freq, clk, si5351_ce_ms_pll(freq)) :
+		si5351_ce_plan_low(ref, freq, clk, si5351_ce_r_div(freq, SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT));
+}
+
+// set_freq() on CLK6 or CLK7, which retunes PLLB
+constexpr struct Si5351ConstPlan si5351_ce_plan_ms67_pll(uint32_t ref, uint64_t freq, uint8_t clk, uint8_t r_div, uint64_t pll_freq, uint32_t a)
+{
+	return {freq, pll_freq, si5351_ce_pll(pll_freq, ref), Si5351RegSet{(uint8_t)a, 0, 0}, clk, SI5351_PLLB, 0, r_div, 0, 0};
+}
+
+constexpr struct Si5351ConstPlan si5351_ce_plan_ms67_div(uint32_t ref, uint64_t freq, uint8_t clk, uint8_t r_div, uint64_t ms_freq)
+{
+	return si5351_ce_plan_ms67_pll(ref, freq, clk, r_div, si5351_ce_ms67(ms_freq) * ms_freq, si5351_ce_ms67(ms_freq));
+}
+
+constexpr struct Si5351ConstPlan si5351_ce_plan_ms67_r(uint32_t ref, uint64_t freq, uint8_t clk, uint8_t r_div)
+{
+	return si5351_ce_plan_ms67_div(ref, freq, clk, r_div, si5351_ce_clamp(freq << r_div,
+		SI5351_MULTISYNTH_MIN_FREQ * SI5351_FREQ_MULT, SI5351_MULTISYNTH67_MAX_FREQ * SI5351_FREQ_MULT));
+}
+
+constexpr struct Si5351ConstPlan si5351_ce_plan_ms67(uint32_t ref, uint64_t freq, uint8_t clk)
+{
+	return si5351_ce_plan_ms67_r(ref, freq, clk, si5351_ce_r_div(freq, SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT));
+}
+
+// The output frequency bounds checks at the top of set_freq()
+constexpr uint64_t si5351_ce_bound(uint64_t freq, uint8_t clk)
+{
+	return (clk <= SI5351_CLK5) ?
+		si5351_ce_clamp(freq, (freq > 0) ? SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT : 0,
+			SI5351_MULTISYNTH_MAX_FREQ * SI5351_FREQ_MULT) :
+		((freq > 0 && freq < SI5351_CLKOUT67_MIN_FREQ * SI5351_FREQ_MULT) ? SI5351_CLKOUT_MIN_FREQ * SI5351_FREQ_MULT :
+		((freq >= SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT) ? SI5351_MULTISYNTH_DIVBY4_FREQ * SI5351_FREQ_MULT - 1 : freq));
+}
+
+template<uint32_t XtalFreq, uint64_t Freq, enum si5351_clock Clk, int32_t Corr>
+constexpr struct Si5351ConstPlan Si5351::plan(void)
+{
+	static_assert(Freq > 0, "Si5351::plan() needs an output frequency");
+
+	return (Clk <= SI5351_CLK5) ?
+		si5351_ce_plan_ms(si5351_ce_ref(si5351_ce_xtal(XtalFreq), Corr), si5351_ce_bound(Freq, Clk), Clk) :
+		si5351_ce_plan_ms67(si5351_ce_ref(si5351_ce_xtal(XtalFreq), Corr), si5351_ce_bound(Freq, Clk), Clk);
+}
+
 #endif /* SI5351_H_ */
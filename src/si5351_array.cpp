@@ -0,0 +1,221 @@
+/*
+ * si5351_array.cpp - Synchronized updates of several Si5351s
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "Arduino.h"
+#include "si5351_array.h"
+
+Si5351Array::Si5351Array(void)
+{
+	chip_count = 0;
+	updating = 0;
+	skew = 0;
+}
+
+/*
+ * add(Si5351 *si5351)
+ *
+ * si5351 - Pointer to an Si5351 object, which may be on any I2C
+ *   address or bus
+ *
+ * Add a chip to the array. The chip must stay in scope for as long
+ * as the array is used.
+ *
+ * Returns the index of the chip in the array, or SI5351_ARRAY_FULL.
+ */
+uint8_t Si5351Array::add(Si5351 *si5351)
+{
+	if(chip_count >= SI5351_ARRAY_MAX)
+	{
+		return SI5351_ARRAY_FULL;
+	}
+
+	chips[chip_count] = si5351;
+	return chip_count++;
+}
+
+/*
+ * count(void)
+ *
+ * Returns the number of chips in the array.
+ */
+uint8_t Si5351Array::count(void)
+{
+	return chip_count;
+}
+
+/*
+ * chip(uint8_t index)
+ *
+ * index - Index returned by add()
+ *
+ * Returns a pointer to the chip, so that any of its methods can be
+ * used between begin_update() and commit(), or NULL.
+ */
+Si5351 *Si5351Array::chip(uint8_t index)
+{
+	if(index >= chip_count)
+	{
+		return NULL;
+	}
+
+	return chips[index];
+}
+
+/*
+ * begin_update(void)
+ *
+ * Start a transaction on every chip in the array. Changes made after
+ * this are only planned in RAM until commit().
+ */
+void Si5351Array::begin_update(void)
+{
+	uint8_t i;
+
+	if(updating)
+	{
+		return;
+	}
+
+	for(i = 0; i < chip_count; i++)
+	{
+		chips[i]->begin_transaction();
+	}
+	updating = 1;
+}
+
+/*
+ * set_freq(uint8_t index, uint64_t freq, enum si5351_clock clk)
+ *
+ * index - Index returned by add()
+ * freq - Output frequency in Hz
+ * clk - Clock output
+ *   (use the si5351_clock enum)
+ *
+ * Plan a set_freq() on one chip of the array. Starts the update if
+ * begin_update() has not been called yet.
+ */
+uint8_t Si5351Array::set_freq(uint8_t index, uint64_t freq, enum si5351_clock clk)
+{
+	if(index >= chip_count)
+	{
+		return 1;
+	}
+
+	begin_update();
+	return chips[index]->set_freq(freq, clk);
+}
+
+/*
+ * set_pll(uint8_t index, uint64_t pll_freq, enum si5351_pll target_pll)
+ *
+ * index - Index returned by add()
+ * pll_freq - Desired PLL frequency
+ * target_pll - Which PLL to set
+ *     (use the si5351_pll enum)
+ *
+ * Plan a set_pll() on one chip of the array. Starts the update if
+ * begin_update() has not been called yet.
+ */
+void Si5351Array::set_pll(uint8_t index, uint64_t pll_freq, enum si5351_pll target_pll)
+{
+	if(index >= chip_count)
+	{
+		return;
+	}
+
+	begin_update();
+	chips[index]->set_pll(pll_freq, target_pll);
+}
+
+/*
+ * commit(void)
+ *
+ * Write out the planned changes of all chips. The staged bursts of the
+ * chips are interleaved, starting the chips with the most bursts first,
+ * so that every chip sends its last burst in the same round. Once all
+ * of the data is out, the final commits, which only carry any PLL
+ * resets, go out back to back.
+ *
+ * Returns 0 on success, or the last non-zero endTransmission() status.
+ */
+uint8_t Si5351Array::commit(void)
+{
+	uint8_t bursts[SI5351_ARRAY_MAX];
+	uint8_t rounds = 0;
+	uint8_t ret_val = 0;
+	uint8_t status;
+	uint8_t i, r;
+	uint32_t first;
+
+	if(!updating)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < chip_count; i++)
+	{
+		bursts[i] = chips[i]->staged_bursts();
+		if(bursts[i] > rounds)
+		{
+			rounds = bursts[i];
+		}
+	}
+
+	// All data bursts of every chip, ending together in the last round
+	for(r = 0; r < rounds; r++)
+	{
+		for(i = 0; i < chip_count; i++)
+		{
+			if(r + bursts[i] >= rounds)
+			{
+				status = chips[i]->commit_step();
+				if(status != 0)
+				{
+					ret_val = status;
+				}
+			}
+		}
+	}
+
+	// Only the PLL resets are left, so these go out back to back
+	first = micros();
+	for(i = 0; i < chip_count; i++)
+	{
+		status = chips[i]->commit();
+		if(status != 0)
+		{
+			ret_val = status;
+		}
+	}
+	skew = chip_count ? micros() - first : 0;
+
+	updating = 0;
+	return ret_val;
+}
+
+/*
+ * get_skew(void)
+ *
+ * Returns the time in microseconds from the start of the first chip's
+ * PLL reset to the end of the last chip's in the last commit().
+ */
+uint32_t Si5351Array::get_skew(void)
+{
+	return skew;
+}
@@ -0,0 +1,47 @@
+/*
+ * si5351_array.h - Synchronized updates of several Si5351s
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SI5351_ARRAY_H_
+#define SI5351_ARRAY_H_
+
+#include "si5351.h"
+
+/* Define definitions */
+
+#define SI5351_ARRAY_MAX                8
+#define SI5351_ARRAY_FULL               0xFF
+
+class Si5351Array
+{
+public:
+	Si5351Array(void);
+	uint8_t add(Si5351 *);
+	uint8_t count(void);
+	Si5351 *chip(uint8_t);
+	void begin_update(void);
+	uint8_t set_freq(uint8_t, uint64_t, enum si5351_clock);
+	void set_pll(uint8_t, uint64_t, enum si5351_pll);
+	uint8_t commit(void);
+	uint32_t get_skew(void);
+private:
+	Si5351 *chips[SI5351_ARRAY_MAX];
+	uint8_t chip_count;
+	uint8_t updating;
+	uint32_t skew;
+};
+
+#endif /* SI5351_ARRAY_H_ */